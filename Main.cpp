@@ -3,18 +3,63 @@
 #include "Video.hpp"
 #include "Audio.hpp"
 #include "Input.hpp"
+#include "Loader.hpp"
+#include "Registry.hpp"
+#include "Animator.hpp"
+#include "Subdivision.hpp"
 
 #include "MD2.hpp"
+#include "Kernel.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
 
 int main(int argc, char** argv) {
 	
 	srand(time(NULL));
 	
+	PROFILE_THREAD("main");
+	
+	/* Note:
+	 * Systems are registered up front, each after the systems it uses,
+	 * and deleted in the reverse order when the engine is.
+	 */
+	
+	RegisterSystem<JobSystem>();
+	RegisterSystem<Subdivision>();
+	RegisterSystem<Animator>();
+	
+	// Benchmark and exit...
+	
+	if (argc > 1 && string(argv[1]) == "--benchmark") {
+		
+		const bool kernels_matched = BenchmarkKernels();
+		const bool jobs_matched = BenchmarkJobs();
+		
+		return (kernels_matched && jobs_matched) ? 0 : 1;
+	}
+	
+	// Check the engine and exit...
+	
+	if (argc > 1 && string(argv[1]) == "--check") {
+		return CheckEngine() ? 0 : 1;
+	}
+	
+	// Keep keyframes quantized, decoding them when drawn (less memory, more work per frame)...
+	
+	if (argc > 1 && string(argv[1]) == "--quantized") {
+		MD2Model::SetDefaultKeyframeStorage(KEYFRAME_STORAGE_QUANTIZED);
+	}
+	
 	// Instantiate core components
+	// Video first: models unload their texture from it as the Loader and Registry delete them
+	
+	Video* gfx = RegisterSystem<Video>();
+	
+	RegisterSystem<Loader>();
+	RegisterSystem<Registry>();
 	
-	Video* gfx = SystemInstance<Video>(); // ie. core.InsertProcess(&typeid(Video), new Video("video"));
-	Audio* sfx = SystemInstance<Audio>();
-	SystemInstance<Input>();
+	Audio* sfx = RegisterSystem<Audio>();
+	RegisterSystem<Input>();
 
 	// ...
 
@@ -23,11 +68,16 @@ int main(int argc, char** argv) {
 	
 	// ...
 	
-	AnimationInfo knight_info = AnimationInfo("data/knight.act");
-	AnimationInfo orgo_info = AnimationInfo("data/orgo.act");
+	// Models load in the background, animations are drawn once their model is ready
+	// Models are shared, and freed with the last animation using them
 	
-	AnimationModel* knight_model    = new MD2Model(knight_info);
-	AnimationModel* orgo_model      = new MD2Model(orgo_info);
+	Registry* assets = SystemInstance<Registry>();
+	
+	LoadHandle<AnimationModel*> knight_load = assets->LoadModel("data/knight.act");
+	LoadHandle<AnimationModel*> orgo_load   = assets->LoadModel("data/orgo.act");
+	
+	AnimationModel* knight_model    = knight_load.Get();
+	AnimationModel* orgo_model      = orgo_load.Get();
 	
 	Animation* knight0 = new Animation("knight", knight_model);
 	knight0->Translate(0.0f, 0.0f, -250.0f);
@@ -40,21 +90,17 @@ int main(int argc, char** argv) {
 	
 	// ...
 	
-	ResourceList* entities = engine.Resources();
-	
-	entities->push_back(knight0);
-	entities->push_back(orgo0);
+	engine.InsertResource(knight0);
+	engine.InsertResource(orgo0);
 	
 	engine.Start();
 	
-	for (unsigned int i = 0 ; i < entities->size(); i++) {
-		delete entities->at(i);
-	}
+	// Models may still be loading if the engine stopped early...
 	
-	entities->clear();
+	knight_load.Wait();
+	orgo_load.Wait();
 	
-	delete knight_model;
-	delete orgo_model;
+	engine.ClearResources();
 	
 	return 0;
 }
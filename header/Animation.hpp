@@ -4,6 +4,8 @@
 #include "Video.hpp"
 #include "Drawable.hpp"
 #include "AnimationModel.hpp"
+#include "Registry.hpp"
+#include "Animator.hpp"
 
 #include <string>
 #include <fstream>
@@ -11,59 +13,86 @@
 using namespace std;
 
 class Animation : public Drawable {
+	
+	friend class Animator;
 
 	private:
 
 		AnimationModel* model;
 		ActionType action;
+		ActionType resident_action; // Action acquired from the model, see AnimationModel::AcquireAction
 		
-		unsigned int frame;
-		float frame_interp;
-
-	protected:
-
-		virtual void Update(const unsigned int& elapsed_milliseconds) {
-
-			model->Render(this);
-
-			float elapsed_seconds = (float)elapsed_milliseconds / 1000.0f;
+		// Frame and interp, advanced by the Animator
+		
+		Animator* animator;
+		unsigned int animator_slot;
+		
+		unsigned int subdivision_depth; // Chosen by the model when drawn, see Video::SelectSubdivisionDepth
+		
+		void AcquireAction() {
 			
-			ActionInfo action_info = model->GetActionInfo(GetAction());
+			if (resident_action == GetAction()) return;
 			
-			float next_frame_interp = frame_interp + ((float)VIDEO_FPS * elapsed_seconds) / (float)action_info.numberOfFrames;
+			model->AcquireAction(GetAction(), resident_action);
 			
-			if (next_frame_interp < 1.0f) {
-				frame_interp = next_frame_interp;
-				return;
+			if (resident_action != INVALID) {
+				model->ReleaseAction(resident_action);
 			}
 			
-			unsigned int next_frame = frame + 1;
+			resident_action = GetAction();
 			
-			if (next_frame < action_info.numberOfFrames) {
-				frame = next_frame;
-				frame_interp = 0.0f;
-				return;
-			}
+			// Play the frames of the action, now that the model is ready...
 			
-			if (action_info.loop) {
-				frame = 0;
-				frame_interp = 0.0f;
+			const ActionInfo& action_info = model->GetActionInfo(GetAction());
+			
+			animator->SetActionFrames(animator_slot, action_info.numberOfFrames, action_info.loop);
+			
+			// Idle animations start on a random frame, so they are not in lockstep (also once a model loads)...
+			
+			if (GetAction() == IDLE && action_info.numberOfFrames > 0) {
+				animator->SetFrame(animator_slot, random<int>(0, action_info.numberOfFrames), 0.0f);
 			}
 		}
 
+	protected:
+
+		virtual void Update(const unsigned int&) {
+			
+			if (model->IsReady() == false) return; // Still loading
+			
+			AcquireAction(); // In case the action was set while loading
+			
+			model->Render(this); // The frames are advanced by the Animator, not here
+		}
+
 	public:
 
 		Animation(const string& name, AnimationModel* model)
 			: Drawable(name)
 			, model(model)
 			, action(INVALID)
-			, frame(0)
-			, frame_interp(0.0f) {
+			, resident_action(INVALID)
+			, animator(SystemInstance<Animator>())
+			, animator_slot(0)
+			, subdivision_depth(0) {
+			
+			model->Retain();
+			
+			animator_slot = animator->Insert(this);
 			
 			SetAction(IDLE); // Default action!
 		}
 
-		virtual ~Animation() {}
+		virtual ~Animation() {
+			
+			animator->Remove(animator_slot);
+			
+			if (resident_action != INVALID) {
+				model->ReleaseAction(resident_action);
+			}
+			
+			SystemInstance<Registry>()->ReleaseModel(model);
+		}
 
 		ActionType GetAction() {
 			return action;
@@ -74,29 +103,29 @@ class Animation : public Drawable {
 			if (GetAction() == new_action) return;
 			action = new_action;
 			
-			// ...
+			// Hold the first frame until the action is acquired...
 			
-			frame = 1;
-			frame_interp = 0.0f;
-
-			ActionInfo action_info = model->GetActionInfo(GetAction());
+			animator->SetFrame(animator_slot, 1, 0.0f);
+			animator->SetActionFrames(animator_slot, 0, false);
 			
-			if (GetAction() == IDLE) {
-				frame = random<int>(0, action_info.numberOfFrames);
-			}
+			if (model->IsReady() == false) return; // Still loading
+			
+			AcquireAction();
 		}
 
 		unsigned int GetFrame() {
-			return frame;
+			return animator->GetFrame(animator_slot);
 		}
 		
 		unsigned int GetFrameIndex(const int& frame_offset) {
 			
 			// Note: frame_offset can be both negative and positive
 
-			const ActionInfo action_info = model->GetActionInfo(GetAction());
+			const ActionInfo& action_info = model->GetActionInfo(GetAction());
+			
+			if (action_info.numberOfFrames <= 0) return action_info.frameIndexOffset;
 			
-			int frame_index = frame + frame_offset;
+			int frame_index = GetFrame() + frame_offset;
 			
 			while (frame_index < 0) {
 				frame_index += action_info.numberOfFrames;
@@ -117,7 +146,15 @@ class Animation : public Drawable {
 		}
 
 		float GetFrameInterp() {
-			return frame_interp;
+			return animator->GetFrameInterp(animator_slot);
+		}
+		
+		unsigned int GetSubdivisionDepth() {
+			return subdivision_depth;
+		}
+		
+		void SetSubdivisionDepth(const unsigned int& depth) {
+			subdivision_depth = depth;
 		}
 };
 
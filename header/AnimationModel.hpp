@@ -13,8 +13,23 @@ using namespace std;
 
 class Animation;
 
+template<typename T> class LoadResult;
+
 enum ActionType {
-	INVALID, IDLE, RUN, JUMP, ATTACK, WAVE, DEAD
+	INVALID, IDLE, RUN, JUMP, ATTACK, WAVE, DEAD,
+	ACTION_MAX
+};
+
+enum ModelLoadMode {
+	MODEL_LOAD_STREAM,  // Read the file into heap allocations
+	MODEL_LOAD_MAPPED,  // Map the file and use the sections in-place (zero-copy)
+	MODEL_LOAD_LAZY     // Map the file and keep only the keyframes of actions in use resident
+};
+
+enum KeyframeStorage {
+	KEYFRAME_STORAGE_DEFAULT,   // Use the global default, see MD2Model::SetDefaultKeyframeStorage
+	KEYFRAME_STORAGE_DECODED,   // Float positions and normals, interpolated as they are (more memory, less work)
+	KEYFRAME_STORAGE_QUANTIZED  // 4 bytes per vertex as in the MD2 file, decoded when drawn (less memory, more work)
 };
 
 struct ActionInfo {
@@ -31,6 +46,7 @@ typedef map<ActionType, ActionInfo> ActionMap;
 class AnimationInfo {
 	
 	friend class AnimationModel;
+	friend class LoadResult<AnimationInfo>;
 	
 	private:
 		
@@ -39,11 +55,13 @@ class AnimationInfo {
 		
 		ActionMap actions;
 		
-		AnimationInfo() {}
+		bool loaded; // See IsLoaded
+		
+		AnimationInfo() : loaded(false) {}
 		
 	public:
 		
-		AnimationInfo(const string& path) {
+		AnimationInfo(const string& path) : loaded(false) {
 			
 			// TODO: Could be written better...
 			
@@ -52,9 +70,11 @@ class AnimationInfo {
 
 			fstream file(path.c_str(), fstream::in);
 
+			// Errors are returned, not asserted: loader workers parse ACT files (see IsLoaded)...
+			
 			if (file.good() == false) {
 				cerr << "ERROR: File failed to load!" << endl;
-				assert(false);
+				return;
 			}
 			
 			getline(file, model_path);
@@ -79,14 +99,20 @@ class AnimationInfo {
 				
 				action_info.type = StringToActionType(action_type_string);
 				
-				assert(action_info.type != INVALID);
-				assert(action_info.frameIndexOffset >= 0);
-				assert(action_info.numberOfFrames > 0);
+				if (action_info.type == INVALID ||
+					action_info.frameIndexOffset < 0 ||
+					action_info.numberOfFrames <= 0) {
+					
+					cerr << "ERROR: Invalid action " << action_type_string << "!" << endl;
+					return;
+				}
 				
 				actions[action_info.type] = action_info;
 			}
 
 			file.close();
+			
+			loaded = true;
 		}
 		
 		AnimationInfo(
@@ -95,7 +121,15 @@ class AnimationInfo {
 			const string& texture_path)
 				: actions(actions)
 				, model_path(model_path)
-				, texture_path(texture_path) {}
+				, texture_path(texture_path)
+				, loaded(true) {}
+		
+		// False if the ACT file could not be read or has an invalid action
+		bool IsLoaded() const { return loaded; }
+		
+		const string& GetModelPath() const { return model_path; }
+		const string& GetTexturePath() const { return texture_path; }
+		const ActionMap& GetActions() const { return actions; }
 		
 		ActionType StringToActionType(const string& action_type_string) {
 			
@@ -127,28 +161,84 @@ class AnimationModel {
 	private:
 		
 		AnimationInfo animation_info;
+		
+		ActionInfo action_table[ACTION_MAX]; // Flat copy of the actions, see GetActionInfo
+		
+		bool ready; // Loaded and uploaded, see IsReady
+		
+		int references; // Animations using this model, see Registry
+		
+		void BuildActionTable() {
+			
+			// Actions missing from the ACT file have no frames...
+			
+			for (int a = 0; a < ACTION_MAX; a++) {
+				action_table[a].type = (ActionType)a;
+				action_table[a].loop = false;
+				action_table[a].frameIndexOffset = 0;
+				action_table[a].numberOfFrames = 0;
+			}
+			
+			for (ActionMap::iterator itr = animation_info.actions.begin(); itr != animation_info.actions.end(); itr++) {
+				if (itr->first <= INVALID || ACTION_MAX <= itr->first) continue;
+				action_table[itr->first] = itr->second;
+			}
+		}
 
-		AnimationModel() {}
+	protected:
+		
+		AnimationModel() : ready(false), references(0) { BuildActionTable(); }
+		
+		void SetAnimationInfo(const AnimationInfo& info) { animation_info = info; BuildActionTable(); }
+		void SetReady(const bool& is_ready) { ready = is_ready; }
 
 	public:
 
-		AnimationModel(const AnimationInfo& animation_info) : animation_info(animation_info) {}
+		AnimationModel(const AnimationInfo& animation_info) : animation_info(animation_info), ready(true), references(0) {
+			BuildActionTable();
+		}
 		
-		AnimationModel(const string& path) {
+		AnimationModel(const string& path) : ready(true), references(0) {
 			animation_info = AnimationInfo(path);
+			BuildActionTable();
 		}
 		
+		virtual ~AnimationModel() {}
+		
+		/* Note:
+		 * A model loaded asynchronously (see Loader) is not ready until its data is uploaded.
+		 * Only the render thread may call any other method of a model that is not ready.
+		 */
+		
+		bool IsReady() { return ready; }
+		
+		// Returns the number of references left
+		int Retain() { return ++references; }
+		int Release() { assert(references > 0); return --references; }
+		
+		int GetReferenceCount() { return references; }
+		
 		virtual void Render(Animation* object) = 0;
 		
+		// Called by Animation when it starts and stops playing an action, see MODEL_LOAD_LAZY
+		virtual void AcquireAction(const ActionType&, const ActionType&) {}
+		virtual void ReleaseAction(const ActionType&) {}
+		
+		// Bytes of model data currently in memory
+		virtual size_t GetMemorySize() { return 0; }
+		
 		string GetModelPath() { return animation_info.model_path; }
 		string GetTexturePath() { return animation_info.texture_path; }
 
-		ActionInfo GetActionInfo(const ActionType& action_type) {
-			return animation_info.actions[action_type];
+		// Constant time, without inserting: an action the model does not define has no frames
+		const ActionInfo& GetActionInfo(const ActionType& action_type) {
+			if (action_type <= INVALID || ACTION_MAX <= action_type) return action_table[INVALID];
+			return action_table[action_type];
 		}
 		
 		void SetActionInfo(const ActionType& action_type, const ActionInfo& action_info) {
 			animation_info.actions[action_type] = action_info;
+			BuildActionTable();
 		}
 		
 		AnimationInfo GetAnimationInfo() { return animation_info; }
@@ -0,0 +1,78 @@
+#ifndef __ANIMATOR_HPP__
+#define __ANIMATOR_HPP__
+
+#include "Process.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define ANIMATOR_PARALLEL_SLOTS (65536) // Fewer slots are advanced on the calling thread
+#define ANIMATOR_RANGE_SLOTS    (16384) // Smallest range of a job
+
+class Animation;
+
+/* Note:
+ * Advances the frames of every Animation in one pass per tick, separately from drawing.
+ * The state of all instances is kept in contiguous arrays (one per field), indexed by slot:
+ * - No virtual call and no action lookup per instance: the action is copied into the slot when it is set
+ * - The pass is a kernel over 32-bit fields, vectorized with SSE2 or AVX2 (see AdvanceFrames in Kernel)
+ * - Ranges of slots are independent, so many slots are split across the job system (see AdvanceRange)
+ * Slots are packed: removing an instance moves the last instance into its slot.
+ *
+ * The Animator is a fixed step system (see ProcessManager::Start): frames only depend on the number of steps.
+ * It keeps the frame of the step before too, so GetFrame and GetFrameInterp blend the last two steps by the step alpha,
+ * and animations stay smooth whatever the frame rate.
+ */
+
+class Animator : public System {
+
+	private:
+
+		vector<unsigned int>    frames;
+		vector<float>           frame_interps;
+		vector<float>           frame_rates;    // Interp per second, see SetActionFrames
+		vector<unsigned int>    frame_counts;   // Frames of the action, 0 holds the frame (eg. while the model loads)
+		vector<unsigned int>    loops;          // 1 if the action loops
+		
+		vector<unsigned int>    previous_frames;        // Before the last step
+		vector<float>           previous_frame_interps;
+
+		vector<Animation*> owners; // By slot, to move a slot
+
+		unsigned int update_microseconds; // Last update
+		
+		// Frame and interp between the last two steps, by the step alpha
+		void GetRenderFrame(const unsigned int& slot, unsigned int& frame, float& frame_interp);
+
+	protected:
+
+		void Update(const unsigned int& elapsed_milliseconds);
+
+	public:
+
+		Animator(const string& name);
+
+		// Returns the slot of the new instance: frame 0, holding
+		unsigned int Insert(Animation* owner);
+		void Remove(const unsigned int& slot);
+
+		void SetFrame(const unsigned int& slot, const unsigned int& frame, const float& frame_interp);
+		void SetActionFrames(const unsigned int& slot, const unsigned int& number_of_frames, const bool& loop);
+
+		// As rendered: interpolated between the last two steps
+		unsigned int GetFrame(const unsigned int& slot);
+		float GetFrameInterp(const unsigned int& slot);
+
+		// Advances slots [first_slot, first_slot + number_of_slots) on the calling thread
+		void AdvanceRange(const float& elapsed_seconds, const unsigned int& first_slot, const unsigned int& number_of_slots);
+
+		// Advances every slot, returns when done
+		void Advance(const float& elapsed_seconds);
+
+		unsigned int GetInstanceCount() { return owners.size(); }
+		unsigned int GetUpdateMicroseconds() { return update_microseconds; }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+#define ARENA_ALIGNMENT     (32)        // Bytes: every span is aligned to this (AVX)
+#define ARENA_BLOCK_SIZE    (1 << 20)   // Bytes: initial capacity
+
+/* Note:
+ * A linear allocator for data that lives for one frame, see Video::GetFrameArena.
+ * - Allocate hands out the next aligned span of the current block, there is no free
+ * - Reset releases every span at once
+ * - When a frame needs more than one block, Reset replaces the blocks with one block
+ *   as large as the high-water mark, so the next frames allocate nothing from the heap
+ */
+
+class Arena {
+
+	private:
+
+		struct Block {
+			char*   data;
+			size_t  size;
+		};
+
+		vector<Block> blocks;   // The last block is the current block
+
+		size_t block_used;      // Bytes used of the current block
+		size_t frame_used;      // Bytes used of every block since Reset
+		size_t high_water_mark; // Most bytes used by a frame
+
+		unsigned int heap_allocations;
+
+		bool AllocateBlock(const size_t& size);
+		void FreeBlocks();
+
+	public:
+
+		Arena(const size_t& initial_size = ARENA_BLOCK_SIZE);
+		~Arena();
+
+		// Returns NULL if out of memory
+		void* Allocate(const size_t& size);
+
+		template<typename T>
+		T* Allocate(const size_t& count) { return (T*)Allocate(count * sizeof(T)); }
+
+		// Every span handed out since the last Reset is released
+		void Reset();
+
+		size_t GetUsed() { return frame_used; }
+		size_t GetCapacity();
+		size_t GetHighWaterMark() { return high_water_mark; }
+
+		// Blocks allocated from the heap so far, constant in steady state
+		unsigned int GetHeapAllocations() { return heap_allocations; }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __JOBSYSTEM_HPP__
+#define __JOBSYSTEM_HPP__
+
+#include "Process.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+#define JOBS_MAX_WORKERS        (15)    // Threads besides the threads that wait on jobs
+#define JOBS_RANGES_PER_THREAD  (4)     // ParallelFor: so threads which finish early take more
+#define JOBS_SPINS              (4096)  // Failed attempts to find a job before a thread sleeps or yields
+
+/* Note:
+ * A work-stealing job system:
+ * - Each worker has its own deque, every other thread (main, loader, ...) shares one more deque
+ * - A thread pushes and pops at the back of its own deque (the most recent job, still in cache),
+ *   and steals from the front of the others (the oldest job, usually the largest range)
+ * - A JobCounter counts the jobs forked with it, Wait joins them
+ * - Wait runs queued jobs until its counter is done, so it is safe from any thread, jobs included:
+ *   a job may fork and wait on jobs of its own
+ * Jobs must not touch GL or SDL events, only the render thread may.
+ */
+
+// Called with a range of indices [first, first + count)
+typedef void (*JobFunction)(void* data, const unsigned int& first, const unsigned int& count);
+
+class JobCounter {
+
+	friend class JobSystem;
+
+	private:
+
+		SDL_atomic_t pending;
+
+	public:
+
+		JobCounter() { SDL_AtomicSet(&pending, 0); }
+
+		bool IsDone() { return SDL_AtomicGet(&pending) == 0; }
+};
+
+struct Job {
+	JobFunction     function;
+	void*           data;
+	unsigned int    first;
+	unsigned int    count;
+	JobCounter*     counter;
+};
+
+struct JobQueue {
+	SDL_SpinLock    lock;
+	deque<Job>      jobs;
+	JobQueue() : lock(0) {}
+};
+
+class JobSystem : public System {
+
+	private:
+
+		vector<SDL_Thread*> workers;
+
+		vector<JobQueue*> queues; // One per worker, then one shared by every other thread
+
+		SDL_atomic_t next_worker_index; // Workers take their queue when they start
+
+		SDL_atomic_t queued_jobs;
+		SDL_atomic_t sleeping_workers;
+		SDL_atomic_t stopping;
+
+		SDL_mutex* mutex;
+		SDL_cond* work_condition; // Signalled when jobs are queued and a worker sleeps
+
+		static int Work(void* jobs);
+
+		// Queue of the calling thread
+		unsigned int GetQueueIndex();
+
+		void Push(const unsigned int& queue_index, const Job& job);
+		void Wake();
+
+		// Own queue first (back), then steals (front)
+		bool Pop(const unsigned int& queue_index, Job& job);
+
+		void Execute(const Job& job);
+
+	protected:
+
+		void Update(const unsigned int&) {}
+
+	public:
+
+		// Workers: -1 for one per core besides the calling thread (up to JOBS_MAX_WORKERS), 0 runs every job on the waiting thread
+		JobSystem(const string& name, const int& number_of_workers = -1);
+		~JobSystem();
+
+		// Fork: queues function(data, first, count) on the calling thread's queue
+		void Run(JobFunction function, void* data, const unsigned int& first, const unsigned int& count, JobCounter& counter);
+
+		// Join: returns once every job of the counter is done, running queued jobs meanwhile
+		void Wait(JobCounter& counter);
+
+		// Calls function over [0, count) in ranges of at least minimum_range, returns when every range is done
+		// The calling thread takes a range too
+		void ParallelFor(JobFunction function, void* data, const unsigned int& count, const unsigned int& minimum_range);
+
+		unsigned int GetWorkerCount() { return workers.size(); }
+};
+
+// Subdivides a mesh with 1 to N threads, reports the time and speedup of each and checks each against 1 thread
+// Returns false if a thread count does not match
+extern bool BenchmarkJobs();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __KERNEL_HPP__
+#define __KERNEL_HPP__
+
+#include <string>
+
+using namespace std;
+
+#define KERNEL_ALIGNMENT    (32)    // Bytes: arrays passed to a kernel are aligned to this (AVX)
+#define KERNEL_WIDTH        (8)     // Floats: array sizes passed to a kernel are a multiple of this
+
+#define KERNEL_TOLERANCE    (1.0e-5f)
+
+/* Note:
+ * Kernels are vectorized with SSE2 (baseline on x86-64) or AVX2,
+ * selected at runtime by what the CPU supports.
+ * Other architectures use the scalar kernels.
+ */
+
+enum KernelLevel {
+	KERNEL_SCALAR,
+	KERNEL_SSE2,
+	KERNEL_AVX2,
+	KERNEL_LEVEL_MAX
+};
+
+// Best level supported by the CPU
+extern KernelLevel GetSupportedKernelLevel();
+
+// Level used by the kernels, the supported level unless set
+extern KernelLevel GetKernelLevel();
+
+// Returns false if the level is not supported
+extern bool SetKernelLevel(const KernelLevel& level);
+
+extern string KernelLevelToString(const KernelLevel& level);
+
+// Linear interpolation: result = a + t * (b - a)
+extern void Interpolate(
+	const float* a,
+	const float* b,
+	const float& t,
+	float* result,
+	const unsigned int& count);
+
+// Advances count animations by elapsed_seconds, see Animator
+// Arrays of any size and alignment: a frame ends when its interp reaches 1,
+// then the next frame starts, or after the last frame (frame_counts) the first if looped, otherwise it holds
+extern void AdvanceFrames(
+	unsigned int* frames,
+	float* frame_interps,
+	const float* frame_rates,
+	const unsigned int* frame_counts,
+	const unsigned int* loops,
+	const float& elapsed_seconds,
+	const unsigned int& count);
+
+// Checks every supported level against the scalar kernels and reports vertices and animations per second
+// Returns false if a level is outside KERNEL_TOLERANCE (animations must match exactly)
+extern bool BenchmarkKernels();
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __LOADER_HPP__
+#define __LOADER_HPP__
+
+#include "Process.hpp"
+#include "Video.hpp"
+#include "AnimationModel.hpp"
+
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+#define LOADER_MAX_WORKERS (4)
+#define LOADER_TICK_RATE   (30) // Per second: uploads loaded jobs
+
+enum LoadState {
+	LOAD_PENDING,   // Queued or loading on a worker thread
+	LOAD_LOADED,    // Loaded, waiting for upload on the render thread
+	LOAD_READY,     // Done
+	LOAD_FAILED     // Done, but failed
+};
+
+class Loader;
+
+class LoadJob {
+
+	friend class Loader;
+
+	private:
+
+		SDL_atomic_t state;
+		SDL_atomic_t references;
+
+		Loader* loader;
+
+	protected:
+
+		// Worker thread: file I/O, parsing, decoding and filtering
+		virtual bool Load() = 0;
+
+		// Render thread: GL upload
+		virtual bool Upload() { return true; }
+
+	public:
+
+		LoadJob();
+		virtual ~LoadJob() {}
+
+		LoadState GetState() { return (LoadState)SDL_AtomicGet(&state); }
+
+		bool IsDone() { return (GetState() == LOAD_READY) || (GetState() == LOAD_FAILED); }
+		bool IsReady() { return (GetState() == LOAD_READY); }
+		bool IsFailed() { return (GetState() == LOAD_FAILED); }
+
+		// Render thread only: blocks until done, uploading finished jobs while waiting
+		void Wait();
+
+		void Retain();
+		void Release();
+};
+
+template<typename T>
+class LoadResult : public LoadJob {
+
+	protected:
+
+		T result;
+
+	public:
+
+		T& Get() { return result; }
+};
+
+/* Note:
+ * A LoadHandle is a reference counted future for a LoadResult.
+ * Poll with IsDone/IsReady/IsFailed or block with Wait (render thread only).
+ */
+
+template<typename T>
+class LoadHandle {
+
+	private:
+
+		LoadResult<T>* job;
+
+	public:
+
+		LoadHandle() : job(NULL) {}
+
+		LoadHandle(LoadResult<T>* job) : job(job) {
+			if (job != NULL) job->Retain();
+		}
+
+		LoadHandle(const LoadHandle<T>& other) : job(other.job) {
+			if (job != NULL) job->Retain();
+		}
+
+		~LoadHandle() {
+			if (job != NULL) job->Release();
+		}
+
+		LoadHandle<T>& operator= (const LoadHandle<T>& other) {
+			if (other.job != NULL) other.job->Retain();
+			if (job != NULL) job->Release();
+			job = other.job;
+			return *this;
+		}
+
+		bool IsValid() { return (job != NULL); }
+
+		bool IsDone() { return (job == NULL) || job->IsDone(); }
+		bool IsReady() { return (job != NULL) && job->IsReady(); }
+		bool IsFailed() { return (job == NULL) || job->IsFailed(); }
+
+		void Wait() {
+			if (job != NULL) job->Wait();
+		}
+
+		T& Get() {
+			assert(job != NULL);
+			return job->Get();
+		}
+};
+
+class Loader : public System {
+
+	friend class LoadJob;
+
+	private:
+
+		vector<SDL_Thread*> workers;
+
+		SDL_mutex* mutex;
+		SDL_cond* pending_condition;    // Signalled when a job is queued
+		SDL_cond* loaded_condition;     // Signalled when a job is loaded
+
+		deque<LoadJob*> pending_jobs;   // Waiting for a worker
+		deque<LoadJob*> loaded_jobs;    // Waiting for the render thread
+
+		bool stopping;
+
+		SDL_atomic_t active_jobs;       // Queued, loading or waiting for upload
+
+		static int Work(void* loader);
+
+		void Queue(LoadJob* job);
+		void Finish(LoadJob* job, const bool& loaded);
+
+	protected:
+
+		// Uploads loaded jobs, on the render thread
+		void Update(const unsigned int& elapsed_milliseconds);
+
+		// Returns false if no jobs were waiting for upload
+		bool UploadLoadedJobs();
+
+	public:
+
+		Loader(const string& name);
+		~Loader();
+
+		// ACT file
+		LoadHandle<AnimationInfo> LoadAnimationInfo(const string& act_path);
+
+		/* Note:
+		 * The model is returned immediately, but is not ready until the handle is.
+		 * So an Animation can be created before the model has finished loading.
+		 * The caller owns the model.
+		 */
+
+		// ACT file, then MD2 model and skin texture
+		// Not shared: load models through Registry::LoadModel so animations share them
+		LoadHandle<AnimationModel*> LoadModel(
+			const string& act_path,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+		
+		LoadHandle<AnimationModel*> LoadModel(
+			const AnimationInfo& animation_info,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+
+		// Texture id, 0 if failed
+		LoadHandle<unsigned int> LoadTexture(const string& path, TextureFilter filter);
+
+		// Number of jobs that are not done
+		unsigned int GetPendingCount();
+};
+
+#endif
@@ -2,9 +2,11 @@
 #define __MD2_HPP__
 
 #include "Animation.hpp"
+#include "Subdivision.hpp"
 
 #include <string>
 #include <fstream>
+#include <vector>
 
 using namespace std;
 
@@ -17,6 +19,19 @@ using namespace std;
 #define MD2_MAX_FRAMES              (512)
 #define MD2_MAX_SKINS               (32)
 #define MD2_MAX_NORMALS             (162)
+#define MD2_MAX_GL_COMMANDS         (16384) // Ints, as in Quake II
+
+#define MD2C_IDENTITY               ("MD2C")
+#define MD2C_VERSION                (4)
+#define MD2C_EXTENSION              ("c")   // Baked file path is the MD2 path + extension, ie. "knight.md2c"
+#define MD2C_ALIGNMENT              (32)    // Bytes: alignment of baked sections (AVX)
+#define MD2C_VERTEX_ALIGNMENT       (8)     // Floats: keyframe arrays are padded to a multiple of this
+#define MD2C_VERTEX_CACHE_SIZE      (32)    // Vertices: post-transform cache size the triangle order is optimized for
+
+#define MD2_RESIDENCY_INTERVAL      (1000)  // Milliseconds: how often unused keyframes are checked for eviction
+#define MD2_RESIDENCY_TIMEOUT       (5000)  // Milliseconds: how long keyframes of a released action stay resident
+
+#define MD2_POSE_CACHE_SIZE         (16)    // Poses: most cached per model per frame, see MD2Model::GetPose
 
 // Quake 2 Model
 
@@ -83,26 +98,254 @@ namespace md2 {
 		char    name[16];
 		Vertex* vertices;
 	};
+
+	/* GL commands:
+	 * A list of ints, each command starts with a count n followed by n command vertices
+	 * - n > 0: triangle strip of n vertices
+	 * - n < 0: triangle fan of -n vertices
+	 * - n = 0: end of list
+	 */
+
+	struct CommandVertex {
+		float   s;              // Texture coordinates (0.0 to 1.0)
+		float   t;
+		int     vertexIndex;
+	};
 }
 
+// Baked Model: engine-native format written the first time an MD2 file is loaded
+
+namespace md2c {
+
+	/* File format:
+	 * 
+		[MD2C Header]
+		[MD2C Data
+			[Frame Names]           @frameOffset
+			[Triangles]             @triangleOffset
+			[Texture Coordinates]   @textureCoordinateOffset
+			[Commands]              @commandOffset
+			[Command Vertices]      @commandVertexOffset
+			[Mesh Vertices]         @meshVertexOffset
+			[Mesh Indices]          @meshIndexOffset
+			[Quantized Frames]      @quantizedFrameOffset
+			[Quantized Vertices]    @quantizedVertexOffset
+			[Keyframes]             @keyframeOffset
+		]                           @endOfFileOffset
+	 * 
+	 * Keyframes are stored twice, see KeyframeStorage:
+	 * - Quantized: the scale and translate of each frame, then numberOfVertices md2::Vertex per frame
+	 * - Decoded: each keyframe is structure-of-arrays: x, y, z, nx, ny, nz
+	 *   Each array holds vertexStride floats and is aligned to MD2C_ALIGNMENT
+	 * The decoded keyframes are last, so a quantized model can skip them when reading the file.
+	 */
+
+	struct Header {
+
+		char    identity[4];    // Model identity (must be equal to "MD2C")
+		int     version;        // MD2C version (must be equal to MD2C_VERSION)
+
+		// Source MD2 file, used to detect a stale baked file...
+
+		long long sourceSize;
+		long long sourceModified;
+
+		md2::Header source;     // Source MD2 header: dimensions and counts
+
+		int vertexStride;       // Number of floats per keyframe array (padded)
+
+		int frameOffset;                // Offset to frame names (16 bytes each)
+		int triangleOffset;             // Offset to triangles (md2::Triangle)
+		int textureCoordinateOffset;    // Offset to s-t texture coordinates (floats, 0.0 to 1.0)
+		int commandOffset;              // Offset to strips and fans (md2c::Command)
+		int commandVertexOffset;        // Offset to strip and fan vertices (md2::CommandVertex)
+		int meshVertexOffset;           // Offset to welded vertices (md2c::MeshVertex)
+		int meshIndexOffset;            // Offset to triangle indices into the welded vertices (unsigned short)
+		int quantizedFrameOffset;       // Offset to frame scale and translate (md2c::QuantizedFrame)
+		int quantizedVertexOffset;      // Offset to frame vertices (md2::Vertex)
+		int keyframeOffset;             // Offset to keyframe data
+
+		int numberOfCommands;
+		int numberOfCommandVertices;
+		int numberOfMeshVertices;
+		int numberOfMeshIndices;
+
+		int endOfFileOffset;            // Offset to end of file
+	};
+
+	struct TextureCoordinate {
+		float s;
+		float t;
+	};
+
+	struct MeshVertex { // Unique pair of vertex and texture coordinate...
+		float   s;
+		float   t;
+		int     vertexIndex;
+	};
+
+	struct Command { // Parsed and validated md2 GL command...
+		int fan;    // Triangle fan if non-zero, otherwise triangle strip
+		int first;  // Index of the first command vertex
+		int count;  // Number of command vertices (at least 3)
+	};
+
+	struct QuantizedFrame { // Axis swapped, so x, y, z are decoded from components x, z, y...
+		float scale[3];
+		float translate[3];
+	};
+
+	struct Keyframe { // Pointers into the baked data (or into the decoded keyframes of a quantized model)...
+		const float* positions[3];  // Decompressed and axis swapped
+		const float* normals[3];    // Resolved from md2::NORMALS
+	};
+}
+
+struct MeshStream { // Static per-model data for one mesh path, see MD2Model::BuildStreams
+	vector<int>             vertex_indices;         // Vertex to shade, in draw order
+	vector<float>           texture_coordinates;    // s, t of each shaded vertex
+	vector<unsigned short>  triangle_indices;       // Triangles, as indices into the shaded vertices
+	
+	// Built on load or first use, see MD2Model::GetSubdivisionTopology
+	SubdivisionTopology     subdivision_topologies[SUBDIVISION_MAX_DEPTH + 1];
+};
+
+struct PoseCacheEntry { // Interpolated keyframe shared by the instances of a model for one frame
+	int             current_frame_index;
+	int             next_frame_index;
+	unsigned int    step;               // Quantized frame_interp, see Video::GetPoseCacheSteps
+	const float*    pose;               // In the frame arena
+};
+
 class MD2Model : public AnimationModel {
 
 	private:
 		
-		int skin_texture;
+		string act_path; // Empty unless constructed from an ACT file
+		ModelLoadMode load_mode;
+		
+		void* skin_image; // Decoded, waiting for UploadTexture
+		unsigned int skin_texture;
 
 		md2::Header             header;
 		md2::TextureCoordinate* texture_coordinates;
 		md2::Triangle*          triangles;
 		md2::Frame*             frames;
+		int*                    graphic_commands;
+		
+		// File mapping: NULL unless loaded with MODEL_LOAD_MAPPED
+		void*                   mapping;
+		size_t                  mapping_size;
+		
+		// Baked model: decoded data used for rendering
+		char*                       baked_data;
+		size_t                      baked_size;
+		bool                        baked_mapped;
+		
+		md2c::TextureCoordinate*    baked_texture_coordinates;
+		md2c::Command*              commands;
+		md2::CommandVertex*         command_vertices;
+		int                         number_of_commands;
+		md2c::MeshVertex*           mesh_vertices;
+		unsigned short*             mesh_indices;
+		int                         number_of_mesh_vertices;
+		int                         number_of_mesh_indices;
+		
+		MeshStream                  streams[MESH_PATH_MAX];
+		md2c::Keyframe*             keyframes;      // NULL unless KEYFRAME_STORAGE_DECODED
+		int                         vertex_stride;  // Floats per keyframe array
+		float*                      pose_buffer;    // Interpolated keyframe, unless cached (see GetPose)
+		float                       bounding_radius; // Model space: bounds every frame, see Video::GetProjectedSize
+		
+		vector<PoseCacheEntry>      pose_cache;         // This frame only
+		unsigned int                pose_cache_frame;   // Video::GetFrameNumber of the entries
+		
+		// Keyframe storage: chosen per model, otherwise default_keyframe_storage
+		KeyframeStorage             keyframe_storage;
+		md2c::QuantizedFrame*       quantized_frames;   // NULL unless KEYFRAME_STORAGE_QUANTIZED
+		md2::Vertex*                quantized_vertices; // Any storage: normal indices for the lighting table
+		md2c::Keyframe              decoded_keyframes[2];       // Point into decoded_buffer
+		int                         decoded_frame_indices[2];   // -1 if not decoded
+		float*                      decoded_buffer;
+		
+		static KeyframeStorage default_keyframe_storage;
 
 		// Lookup table: maps frame name to frame index
 		map<string, int> frame_lookup;
 		
-		void LoadModel(const string& md2_path);
+		// Keyframe residency: only used with MODEL_LOAD_LAZY (and a mapped baked model)
+		vector<bool>    resident_frames;                                // Keyframes advised in, not yet evicted
+		int             action_users[ACTION_MAX];                       // Number of animations playing each action
+		unsigned int    action_released[ACTION_MAX];                    // Ticks when each action was last released, or prefetched
+		unsigned int    action_transitions[ACTION_MAX][ACTION_MAX];     // Learned: times action a was followed by action b
+		unsigned int    last_eviction;                                  // Ticks
+		
+		bool ValidateHeader(const size_t& md2_file_size);
+		bool IsSectionInFile(const int& offset, const size_t& size, const size_t& md2_file_size);
+		unsigned int GetFrameSize();
+		
+		bool LoadModel(const string& md2_path);
+		bool MapModel(const string& md2_path);
 		void UnloadModel();
-
-		void LoadTexture(const string& skin_path);
+		
+		bool BakeCommands(vector<md2c::Command>& baked_commands, vector<md2::CommandVertex>& baked_command_vertices);
+		bool BakeMesh(const vector<md2::Triangle>& valid_triangles, vector<md2c::MeshVertex>& baked_vertices, vector<unsigned short>& baked_indices);
+		bool BakeModel(const string& md2_path);
+		bool AttachBakedModel(char* data, const size_t& size, const bool& mapped);
+		bool LoadBakedModel(const string& md2c_path, const string& md2_path, const ModelLoadMode& load_mode);
+		bool SaveBakedModel(const string& md2c_path);
+		void UnloadBakedModel();
+		void BuildStreams();
+		const SubdivisionTopology& GetSubdivisionTopology(const MeshPath& mesh_path, const unsigned int& depth);
+		
+		void GetKeyframeSection(size_t& offset, size_t& frame_size);
+		void DecodeKeyframe(const int& frame_index, const int& slot);
+		void GetKeyframes(const int& current_frame_index, const int& next_frame_index, md2c::Keyframe& current_frame, md2c::Keyframe& next_frame);
+		size_t GetResidentSize(const size_t& begin, const size_t& end);
+		
+		bool IsResidencyManaged();
+		void ResetResidency();
+		bool GetActionFrames(const ActionType& action, int& first_frame, int& number_of_frames);
+		void AdviseKeyframes(const int& first_frame, const int& number_of_frames, const int& advice);
+		void PrefetchAction(const ActionType& action);
+		void EvictActions();
+
+		// Interpolated keyframes (6 arrays of vertex_stride floats), shared by instances showing the same pose this frame
+		// interp is frame_interp as used: zero without interpolation, quantized when cached
+		const float* GetPose(
+			Video* gfx,
+			const int& current_frame_index,
+			const int& next_frame_index,
+			const float& frame_interp,
+			float& interp);
+		
+		// Lights the vertices of a stream in the pose into the render buffers
+		// Each buffer holds 3 floats per vertex of the stream
+		void ShadeVertices(
+			Video* gfx,
+			const MeshStream& stream,
+			const float* pose,
+			const int& current_frame_index,
+			const int& next_frame_index,
+			const float& interp,
+			const glm::vec4& light_position,
+			float* colour_buffer,
+			float* normal_buffer,
+			float* vertex_buffer);
+		
+		// Queues the light, view and normal vectors of the shaded vertices, see Video::AddDebugLine
+		// Model space, orientation maps them to world space
+		void DrawDebugVectors(
+			Video* gfx,
+			const glm::mat4& orientation,
+			const glm::vec4& light_position,
+			const glm::vec4& view_position,
+			const float* normal_buffer,
+			const float* vertex_buffer,
+			const unsigned int& number_of_vertices);
+
+		bool LoadTexture(const string& skin_path);
+		bool UploadTexture();
 		void UnloadTexture();
 
 	protected:
@@ -114,12 +357,51 @@ class MD2Model : public AnimationModel {
 
 	public:
 
-		MD2Model(const AnimationInfo& animation_info);
-		MD2Model(const string& act_path);
+		/* Note:
+		 * Unless defer_loading is set, the model is loaded and uploaded by the constructor.
+		 * Otherwise, call Load (from any thread) and then Upload (from the render thread), see Loader.
+		 */
+		
+		MD2Model(
+			const AnimationInfo& animation_info,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const bool& defer_loading = false,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+		
+		MD2Model(
+			const string& act_path,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const bool& defer_loading = false,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
 
 		~MD2Model();
+		
+		// File I/O, parsing, decoding and texture filtering
+		bool Load();
+		
+		// GL upload, the model is ready afterwards
+		bool Upload();
 
 		void Render(Animation* object);
+		
+		// Keyframe residency, see MODEL_LOAD_LAZY
+		void AcquireAction(const ActionType& action, const ActionType& previous_action);
+		void ReleaseAction(const ActionType& action);
+		
+		// Used by models constructed with KEYFRAME_STORAGE_DEFAULT
+		static void SetDefaultKeyframeStorage(const KeyframeStorage& storage);
+		static string KeyframeStorageToString(const KeyframeStorage& storage);
+		
+		KeyframeStorage GetKeyframeStorage() { return keyframe_storage; }
+		
+		// Bytes of keyframe data under the storage policy, resident or not
+		size_t GetKeyframeSize();
+		
+		// Bytes of keyframe data currently in memory
+		size_t GetResidentKeyframeSize();
+		
+		// Bytes of baked data currently in memory, plus render buffers and streams
+		size_t GetMemorySize();
 	};
 
 #endif
@@ -4,6 +4,8 @@
 #include <cassert>
 #include <cstdlib>
 
+#include <string>
+
 #define sizeof_member(T,F) (sizeof(((T*)0)->F))
 
 template<typename T>
@@ -19,4 +21,18 @@ inline T random(const T& min, const T& max) {
 	return r;
 }
 
+// Resolves ".", ".." and symbolic links, so the same file always has the same key
+// Returns path unchanged if it cannot be resolved
+inline std::string CanonicalPath(const std::string& path) {
+	
+	char* resolved_path = realpath(path.c_str(), NULL);
+	
+	if (resolved_path == NULL) return path;
+	
+	std::string canonical_path(resolved_path);
+	free(resolved_path);
+	
+	return canonical_path;
+}
+
 #endif
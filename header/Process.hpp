@@ -6,8 +6,18 @@
 #include <vector>
 #include <map>
 
+#include "SlotMap.hpp"
+
 using namespace std;
 
+#define SYSTEM_TICK_ALWAYS      (0)     // Ticks per second: every iteration of the main loop
+#define SYSTEM_TICK_NEVER       (-1)    // Ticks per second: never updated (the system only serves calls)
+
+#define ENGINE_STEP_MILLISECONDS    (10)    // Fixed simulation step (100 steps per second), see ProcessManager::Start
+#define ENGINE_MAX_STEPS            (25)    // Steps per frame at most, the time of a longer stall is dropped
+#define ENGINE_FRAME_LIMIT          (0)     // Frames per second at most by default, 0 for no limit
+#define ENGINE_SPIN_MILLISECONDS    (1)     // Frame limit: the end of the wait is spun rather than slept
+
 class Process;
 class ProcessManager;
 
@@ -19,7 +29,9 @@ extern bool operator< (const System& a, const System& b);
 extern bool operator== (const System& a, const System& b);
 
 typedef map<const type_info*, System*> SystemMap;
-typedef vector<Resource*> ResourceList;
+typedef SlotMap<Resource*> ResourceList;
+typedef SlotHandle ResourceHandle;
+typedef vector<System*> SystemList;
 
 class Process {
 	
@@ -38,21 +50,59 @@ class Process {
 	public:
 		
 		Process(const string& name) : name(name) {}
+		virtual ~Process() {}
 		
 		virtual string Name() { return name; }
 };
 
 class System : public Process {
 	
+	friend class ProcessManager;
+	
 	private:
 	
 		bool running;
 		
+		// Schedule, see ProcessManager::Schedule
+		
+		vector<const type_info*> dependencies;
+		
+		int ticks_per_second;
+		bool fixed_step;
+		
+		bool is_scheduled;
+		unsigned int last_tick_milliseconds;
+		unsigned int next_tick_milliseconds;
+		
 		//System() {}
 		
+	protected:
+		
+		/* Note:
+		 * Declared by each system in its constructor:
+		 * - RunAfter: the system is updated after the given system, if there is one
+		 * - SetTickRate: updates per second at most, SYSTEM_TICK_ALWAYS or SYSTEM_TICK_NEVER
+		 * - SetFixedStep: the system is part of the simulation, it updates on fixed steps (see ProcessManager::Step)
+		 *   rather than once per frame, and is always given a whole number of steps
+		 */
+		
+		void RunAfter(const type_info* system_type) { dependencies.push_back(system_type); }
+		void SetTickRate(const int& rate) { ticks_per_second = rate; }
+		void SetFixedStep(const bool& is_fixed_step) { fixed_step = is_fixed_step; }
+		
 	public:
 		
-		System(const string& name) : Process(name), running(true) {}
+		System(const string& name)
+			: Process(name)
+			, running(true)
+			, ticks_per_second(SYSTEM_TICK_ALWAYS)
+			, fixed_step(false)
+			, is_scheduled(false)
+			, last_tick_milliseconds(0)
+			, next_tick_milliseconds(0) {}
+		
+		int GetTickRate() { return ticks_per_second; }
+		bool IsFixedStep() { return fixed_step; }
 		
 		virtual void Start() { running = true; }
 		virtual void Stop() { running = false; }
@@ -66,10 +116,12 @@ class System : public Process {
 class Resource : public Process {
 	
 	friend class System;
+	friend class ProcessManager;
 	
 	private:
 		
 		bool touched; // Touched/used by a system
+		bool is_new; // Inserted since the last frame, not yet required to be touched
 		
 		//Resource() {}
 		
@@ -79,22 +131,53 @@ class Resource : public Process {
 		
 	public:
 		
-		Resource(const string& name) : Process(name), touched(false) {}
+		Resource(const string& name) : Process(name), touched(false), is_new(true) {}
 		
 		bool IsTouched() { return touched; }
 };
 
 class ProcessManager : public System {
 	
+	friend class EngineCheck; // See CheckEngine
+	
 	private:
 		
 		SystemMap systems; // permanent
+		SystemList system_slots; // By slot (see SystemSlot), NULL until registered
+		SystemList registered_systems; // In the order they were registered, deleted in reverse
+		bool is_deleting_systems; // See ~ProcessManager: systems are not registered again once deleted
 		ResourceList resources; // allocated / deallocated
+		vector<ResourceHandle> destroyed_resources; // Deleted at the end of the frame, see DestroyResource
+		
+		// Waves of systems in dependency order, see Schedule
+		
+		vector<SystemList> schedule;
+		bool is_schedule_valid;
+		
+		unsigned int clock_milliseconds; // Frame clock: sum of the elapsed time of every frame
+		unsigned int simulation_milliseconds; // Simulation clock: sum of every step
+		
+		float step_alpha; // See GetStepAlpha
+		
+		unsigned int frame_limit; // Frames per second at most, 0 for no limit
 		
 		//ProcessManager() {}
 		
+		// Orders the systems by their dependencies, see Update
+		void Schedule();
+		
+		// Returns true if the system is due, and its elapsed time since it last updated
+		bool IsDue(System* system, const unsigned int& milliseconds, unsigned int& elapsed_milliseconds);
+		
+		// Deletes the resources queued by DestroyResource
+		void DeleteDestroyedResources();
+		
+		// Updates the due systems of a phase (fixed step or frame), on the clock of that phase
+		void RunSystems(const bool& is_fixed_step, const unsigned int& milliseconds);
+		
 	protected:
 		
+		// One frame: the systems which are not fixed step, then resources
 		void Update(const unsigned int& elapsed_milliseconds);
 
 	public:
@@ -104,25 +187,105 @@ class ProcessManager : public System {
 		
 		void Start();
 		
+		// One step of ENGINE_STEP_MILLISECONDS: the fixed step systems
+		void Step();
+		
+		// Fraction of a step since the last step, in [0, 1): render interpolates the simulation between its last two steps
+		float GetStepAlpha() { return step_alpha; }
+		
+		void SetFrameLimit(const unsigned int& frames_per_second) { frame_limit = frames_per_second; }
+		unsigned int GetFrameLimit() { return frame_limit; }
+		void CycleFrameLimit();
+		
 		bool ContainsSystem(const type_info* system_type);
-		bool InsertSystem(const type_info*, System* system);
 		System* FindSystem(const type_info* system_type);
 		
+		// See RegisterSystem
+		bool InsertSystem(const type_info* system_type, const unsigned int& slot, System* system);
+		
+		// Returns NULL if no system has the slot
+		System* FindSystem(const unsigned int& slot) {
+			return (slot < system_slots.size()) ? system_slots[slot] : NULL;
+		}
+		
+		bool IsDeletingSystems() { return is_deleting_systems; }
+		
+		void ReportUnregisteredSystem(const type_info* system_type);
+		
+		/* Note:
+		 * Resources are kept in a slot map: a handle stays valid until its resource is destroyed, then is stale (never dangling).
+		 * Destroying is deferred to the end of the frame, after every system updated,
+		 * so a system may destroy resources (its own included) while systems iterate them.
+		 */
+		
+		// The engine owns the resource from now on
+		ResourceHandle InsertResource(Resource* resource);
+		
+		// Returns NULL if the resource was destroyed
+		Resource* FindResource(const ResourceHandle& handle);
+		
+		// The resource is deleted at the end of the frame, destroying it twice is harmless
+		void DestroyResource(const ResourceHandle& handle);
+		
+		// Deletes every resource now, outside of a frame (eg. before the systems the resources use are deleted)
+		void ClearResources();
+		
+		// Dense, iterate with Size and At
 		ResourceList* Resources();
+		
+		// Prints the waves of systems, their tick rates and where they update
+		void ReportSchedule();
 };
 
+/* Note:
+ * Each system type has a slot: a dense index into the systems of the engine,
+ * given out once per type, the first time its slot is asked for (NextSystemSlot).
+ * Finding a system is then an indexed load, rather than a lookup of its type in a map.
+ */
+
+extern unsigned int NextSystemSlot();
+
+template<typename S>
+inline unsigned int SystemSlot() {
+	static const unsigned int slot = NextSystemSlot();
+	return slot;
+}
+
+// Creates the system, once: systems are deleted in the reverse order they were registered in
+template<typename S>
+S* RegisterSystem() {
+	
+	const unsigned int slot = SystemSlot<S>();
+	System* system = engine.FindSystem(slot);
+	
+	if (system == NULL) {
+		system = new S(typeid(S).name());
+		engine.InsertSystem(&typeid(S), slot, system);
+	}
+	
+	return static_cast<S*>(system);
+}
+
 template<typename S>
 S* SystemInstance() {
 	
-	const type_info* system_type = &typeid(S);
-	System* system = engine.FindSystem(system_type);
+	System* system = engine.FindSystem(SystemSlot<S>());
+	
+	// Every system should be registered up front, see Main...
 	
 	if (system == NULL) {
-		system = new S(system_type->name());
-		engine.InsertSystem(system_type, system);
+		
+		if (engine.IsDeletingSystems()) return NULL; // Deleted already, see ~ProcessManager
+		
+		engine.ReportUnregisteredSystem(&typeid(S));
+		return RegisterSystem<S>();
 	}
 	
 	return static_cast<S*>(system);
 }
 
+// Runs engines of check systems and resources: the slot map, deferred destruction, the schedule, the fixed step,
+// the frame limit and the order systems are deleted in. Returns false if a check fails
+extern bool CheckEngine();
+
 #endif
@@ -0,0 +1,87 @@
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+
+#include <string>
+
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+#define PROFILER_EVENTS_PER_THREAD  (65536)             // Power of 2: the ring buffer of a thread, older zones are overwritten
+#define PROFILER_MAX_THREADS        (32)                // Threads past this are not profiled
+#define PROFILER_TRACE_PATH         ("profile.json")    // See Profiler::Export
+
+/* Note:
+ * A scoped zone profiler:
+ * - PROFILE_ZONE("name") times the rest of the enclosing scope (the name must be a literal, or outlive the capture)
+ * - Zones nest by time, so a zone inside another is shown under it
+ * - Each thread records its zones in its own ring buffer, without locks: only the last zones of each thread are kept
+ * - Profiler::Export writes the zones of every thread as a Chrome trace (chrome://tracing, or ui.perfetto.dev)
+ * Zones are only compiled in when PROFILER_ENABLED is defined (make PROFILE=1), otherwise they cost nothing.
+ */
+
+#ifdef PROFILER_ENABLED
+
+	#define PROFILE_CONCATENATE_(a, b)  a##b
+	#define PROFILE_CONCATENATE(a, b)   PROFILE_CONCATENATE_(a, b)
+
+	#define PROFILE_ZONE(name)          ProfileZone PROFILE_CONCATENATE(profile_zone_, __LINE__)(name)
+	#define PROFILE_THREAD(name)        Profiler::SetThreadName(name)
+
+#else
+
+	#define PROFILE_ZONE(name)
+	#define PROFILE_THREAD(name)
+
+#endif
+
+struct ProfileEvent {
+	const char*     name;
+	Uint64          start_ticks;    // SDL_GetPerformanceCounter
+	Uint64          end_ticks;
+};
+
+struct ProfileBuffer {
+
+	ProfileEvent    events[PROFILER_EVENTS_PER_THREAD];
+	volatile unsigned int written;  // Events ever recorded, only the thread of the buffer writes
+
+	const char*     thread_name;
+	unsigned int    thread_index;   // Order the thread first recorded a zone in
+};
+
+class Profiler {
+
+	private:
+
+		// Of the calling thread, NULL past PROFILER_MAX_THREADS
+		static ProfileBuffer* GetThreadBuffer();
+
+	public:
+
+		static void Record(const char* name, const Uint64& start_ticks, const Uint64& end_ticks);
+
+		// Shown as the name of the calling thread in the trace
+		static void SetThreadName(const char* name);
+
+		static bool IsEnabled();
+
+		// Writes the zones recorded so far by every thread (the last PROFILER_EVENTS_PER_THREAD of each),
+		// returns false if the profiler is compiled out or the file could not be written
+		static bool Export(const string& path);
+};
+
+class ProfileZone {
+
+	private:
+
+		const char* name;
+		Uint64 start_ticks;
+
+	public:
+
+		ProfileZone(const char* name) : name(name), start_ticks(SDL_GetPerformanceCounter()) {}
+		~ProfileZone() { Profiler::Record(name, start_ticks, SDL_GetPerformanceCounter()); }
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef __REGISTRY_HPP__
+#define __REGISTRY_HPP__
+
+#include "Process.hpp"
+#include "Loader.hpp"
+#include "AnimationModel.hpp"
+
+#include <string>
+#include <map>
+
+using namespace std;
+
+#define REGISTRY_TICK_RATE (4) // Per second: deletes models released while loading
+
+struct ModelEntry {
+
+	string key;
+	string name; // Model and skin paths, for reports
+
+	AnimationModel* model;
+	LoadHandle<AnimationModel*> load;
+};
+
+typedef map<string, ModelEntry> ModelMap;
+
+/* Note:
+ * Shares models between animations, so memory scales with unique assets, not instances.
+ * - Models are keyed by what they load: the canonical paths of the MD2 model and skin texture named by the ACT file,
+ *   and its actions (a model holds them), so ACT files naming the same data share one model
+ * - Skin textures are shared by Video, keyed by canonical path and filter
+ * - An Animation retains its model, a registered model is deleted when the last Animation releases it
+ */
+
+class Registry : public System {
+
+	private:
+
+		ModelMap models;
+
+		map<AnimationModel*, string> model_keys;
+
+		vector<ModelEntry> released_models; // Released while still loading
+
+		// See the note above
+		string GetModelKey(const AnimationInfo& animation_info);
+		
+		LoadHandle<AnimationModel*> InsertModel(const string& key, const string& name, const LoadHandle<AnimationModel*>& load);
+		
+		void DeleteModel(ModelEntry& entry);
+
+	protected:
+
+		// Deletes released models once their load has finished
+		void Update(const unsigned int& elapsed_milliseconds);
+
+	public:
+
+		Registry(const string& name);
+		~Registry();
+
+		// Asynchronous, see Loader (the ACT file itself is read here, to key the model)
+		// Returns the shared model if its data is already registered (the load mode and keyframe storage of the first load win)
+		LoadHandle<AnimationModel*> LoadModel(
+			const string& act_path,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+		
+		LoadHandle<AnimationModel*> LoadModel(
+			const AnimationInfo& animation_info,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+
+		// Synchronous
+		AnimationModel* AcquireModel(
+			const string& act_path,
+			const ModelLoadMode& load_mode = MODEL_LOAD_MAPPED,
+			const KeyframeStorage& keyframe_storage = KEYFRAME_STORAGE_DEFAULT);
+
+		bool IsRegistered(AnimationModel* model);
+
+		// Called by Animation, models which are not registered are left to their owner
+		void ReleaseModel(AnimationModel* model);
+
+		unsigned int GetModelCount() { return models.size(); }
+
+		// Prints the memory used by each registered model, returns the total in bytes
+		size_t ReportMemory();
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef __SLOTMAP_HPP__
+#define __SLOTMAP_HPP__
+
+#include <vector>
+
+#include <cassert>
+#include <cstddef>
+
+using namespace std;
+
+#define SLOT_MAP_NO_SLOT    (0xFFFFFFFF)    // End of the free list, and the slot of a null handle
+
+/* Note:
+ * A SlotHandle names an item of a SlotMap: its slot, and the generation of the slot when the item was inserted.
+ * Removing an item bumps the generation of its slot, so old handles to the slot are stale rather than dangling,
+ * even once the slot holds another item.
+ */
+
+struct SlotHandle {
+
+	unsigned int index;         // Slot
+	unsigned int generation;    // 0 is never valid
+
+	SlotHandle() : index(SLOT_MAP_NO_SLOT), generation(0) {}
+	SlotHandle(const unsigned int& index, const unsigned int& generation) : index(index), generation(generation) {}
+
+	bool IsNull() const { return generation == 0; }
+};
+
+inline bool operator== (const SlotHandle& a, const SlotHandle& b) {
+	return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!= (const SlotHandle& a, const SlotHandle& b) {
+	return !(a == b);
+}
+
+/* Note:
+ * Items are kept dense, in one array, so iterating them is a plain loop (see Size and At),
+ * and slots map handles to items:
+ * - Insert takes a free slot (or a new one) and appends the item
+ * - Remove moves the last item into the hole and repoints its slot, then frees the slot
+ * Both are O(1). The order of the items changes when one is removed, handles do not.
+ */
+
+template<typename T>
+class SlotMap {
+
+	private:
+
+		struct Slot {
+			unsigned int item_index;    // Dense index of the item, or the next free slot when free
+			unsigned int generation;
+		};
+
+		vector<T> items;
+		vector<unsigned int> item_slots; // Slot of each item
+
+		vector<Slot> slots;
+		unsigned int free_slot; // Head of the free list
+
+	public:
+
+		SlotMap() : free_slot(SLOT_MAP_NO_SLOT) {}
+
+		SlotHandle Insert(const T& item) {
+
+			unsigned int index = free_slot;
+
+			if (index == SLOT_MAP_NO_SLOT) {
+
+				Slot slot;
+
+				slot.generation = 1;
+
+				index = slots.size();
+				slots.push_back(slot);
+
+			} else {
+				free_slot = slots[index].item_index;
+			}
+
+			slots[index].item_index = items.size();
+
+			items.push_back(item);
+			item_slots.push_back(index);
+
+			return SlotHandle(index, slots[index].generation);
+		}
+
+		// Returns false if the handle is stale
+		bool Remove(const SlotHandle& handle) {
+
+			if (Contains(handle) == false) return false;
+
+			Slot& slot = slots[handle.index];
+
+			// Move the last item into the hole...
+
+			const unsigned int item_index = slot.item_index;
+			const unsigned int last = items.size() - 1;
+
+			if (item_index != last) {
+				items[item_index] = items[last];
+				item_slots[item_index] = item_slots[last];
+				slots[item_slots[item_index]].item_index = item_index;
+			}
+
+			items.pop_back();
+			item_slots.pop_back();
+
+			// Stale every handle to the slot, then free it...
+
+			if (++slot.generation == 0) slot.generation = 1;
+
+			slot.item_index = free_slot;
+			free_slot = handle.index;
+
+			return true;
+		}
+
+		bool Contains(const SlotHandle& handle) const {
+			return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+		}
+
+		// Returns NULL if the handle is stale
+		T* Find(const SlotHandle& handle) {
+
+			if (Contains(handle) == false) return NULL;
+
+			return &items[slots[handle.index].item_index];
+		}
+
+		void Clear() {
+			while (items.empty() == false) {
+				Remove(HandleAt(items.size() - 1));
+			}
+		}
+
+		// Dense items, [0, Size())
+
+		unsigned int Size() const { return items.size(); }
+		bool Empty() const { return items.empty(); }
+
+		T& At(const unsigned int& item_index) {
+			assert(item_index < items.size());
+			return items[item_index];
+		}
+
+		SlotHandle HandleAt(const unsigned int& item_index) const {
+			assert(item_index < items.size());
+			return SlotHandle(item_slots[item_index], slots[item_slots[item_index]].generation);
+		}
+};
+
+#endif
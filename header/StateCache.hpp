@@ -0,0 +1,81 @@
+#ifndef __STATECACHE_HPP__
+#define __STATECACHE_HPP__
+
+#include <map>
+#include <utility>
+
+using namespace std;
+
+/* Note:
+ * Shadows the fixed-function GL state the engine changes, so calls that change nothing are skipped:
+ * - Enable bits (glEnable, glDisable) and client arrays (glEnableClientState, glDisableClientState)
+ * - The bound 2D texture, the line width and light parameters
+ * State is unknown until first set (or after Invalidate), and unknown state is always set.
+ * Every state change of the engine must go through here, otherwise the shadow is stale: call Invalidate.
+ *
+ * Light positions and spot directions are transformed by the modelview matrix when set,
+ * so the same values are not the same state: they are always set.
+ */
+
+class StateCache {
+
+	private:
+
+		struct LightParameter {
+			unsigned int    count;      // 0 until set
+			float           values[4];
+			LightParameter() : count(0) {}
+		};
+
+		map<unsigned int, bool> capabilities;           // Enable bits, by GL enum
+		map<unsigned int, bool> client_states;          // Client arrays, by GL enum
+
+		bool is_texture_known;
+		unsigned int bound_texture;                     // GL_TEXTURE_2D
+
+		bool is_line_width_known;
+		float line_width;
+
+		map<pair<unsigned int, unsigned int>, LightParameter> light_parameters; // By light and parameter
+
+		// This frame, and the last frame (see EndFrame)...
+
+		unsigned int issued_calls;
+		unsigned int filtered_calls;
+
+		unsigned int frame_issued_calls;
+		unsigned int frame_filtered_calls;
+
+		// Returns true if the call changes state (and records the change)
+		bool Change(map<unsigned int, bool>& states, const unsigned int& key, const bool& value);
+
+	public:
+
+		StateCache();
+
+		// Forgets every shadowed state, ie. after GL calls that bypass the cache
+		void Invalidate();
+
+		void Enable(const unsigned int& capability);
+		void Disable(const unsigned int& capability);
+
+		void EnableClientState(const unsigned int& array);
+		void DisableClientState(const unsigned int& array);
+
+		// GL_TEXTURE_2D
+		void BindTexture(const unsigned int& texture_id);
+		void DeleteTexture(const unsigned int& texture_id);
+
+		void LineWidth(const float& width);
+
+		// count: number of values in parameters (1 to 4)
+		void Light(const unsigned int& light, const unsigned int& parameter, const float* parameters, const unsigned int& count);
+
+		// Counters of the frame so far, moved to the frame counters by EndFrame
+		void EndFrame();
+
+		unsigned int GetIssuedCalls() { return frame_issued_calls; }
+		unsigned int GetFilteredCalls() { return frame_filtered_calls; }
+};
+
+#endif
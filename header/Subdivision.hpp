@@ -0,0 +1,142 @@
+#ifndef __SUBDIVISION_HPP__
+#define __SUBDIVISION_HPP__
+
+#include "Process.hpp"
+#include "JobSystem.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define SUBDIVISION_MAX_DEPTH           (4)
+#define SUBDIVISION_PARALLEL_VERTICES   (16384) // Output vertices: smaller batches are subdivided on the calling thread
+#define SUBDIVISION_RANGE_TRIANGLES     (16)    // Triangles: smallest range of a job
+#define SUBDIVISION_RANGE_VERTICES      (1024)  // Vertices: smallest range of a job (indexed)
+
+/* Note:
+ * Subdivision splits each triangle into 4, depth times, so a triangle becomes 3 * 4^depth vertices.
+ * Every output vertex is a fixed barycentric blend of the 3 corners of its triangle,
+ * so the weights are computed once per depth (a template), in the order of the recursive split:
+ *
+ *          [a]
+ *          / \
+ *         /   \
+ *     (x)/-----\(y)
+ *       / \   / \
+ *      /___\ /___\
+ *    [b]   (z)   [c]
+ *
+ *   (a, x, y), (x, b, z), (y, z, c), (z, y, x)
+ *
+ * Expanded: every triangle writes its own 3 * 4^depth vertices (see Subdivide),
+ * so a point on an edge is computed by both triangles of the edge, and an interior point up to 6 times.
+ * Indexed: every point is computed once and shared through an index buffer (see SubdivideIndexed),
+ * points on an edge are keyed by the corners of the edge, so neighbouring triangles share them.
+ */
+
+struct SubdivisionTemplate {
+	unsigned int    depth;
+	unsigned int    number_of_vertices;     // Per triangle: 3 * 4^depth
+	vector<float>   weights;                // Per vertex: weight of a, b and c
+};
+
+struct SubdividedVertex { // Blend of up to 3 shaded vertices
+	unsigned short  corners[3];
+	float           weights[3];
+};
+
+struct SubdivisionTopology { // Indexed subdivision of a triangle list, see Subdivision::BuildTopology
+	unsigned int                depth;
+	vector<SubdividedVertex>    vertices;               // Each point once: corners, edge points, interior points
+	vector<float>               texture_coordinates;    // Static: 2 per vertex
+	vector<unsigned int>        triangle_indices;       // 3 per subdivided triangle, into vertices
+};
+
+// Corners of the triangles: attributes of the shaded vertices, indexed by triangle_indices
+struct SubdivisionInput {
+	const unsigned short*   triangle_indices;       // 3 per triangle
+	const float*            texture_coordinates;    // 2 per vertex
+	const float*            colours;                // 3 per vertex
+	const float*            normals;                // 3 per vertex
+	const float*            vertices;               // 3 per vertex
+};
+
+// Preallocated:
+// - Expanded: independent triangles, SubdividedVertexCount vertices per input triangle
+// - Indexed: one vertex per topology vertex, without texture coordinates (they are static)
+struct SubdivisionOutput {
+	float* texture_coordinates;
+	float* colours;
+	float* normals;
+	float* vertices;
+};
+
+class Subdivision : public System {
+
+	private:
+
+		SubdivisionTemplate templates[SUBDIVISION_MAX_DEPTH + 1];
+
+		JobSystem* jobs;
+
+		void BuildTemplate(const unsigned int& depth);
+
+	protected:
+
+		void Update(const unsigned int&) {}
+
+	public:
+
+		Subdivision(const string& name);
+		~Subdivision();
+
+		// Clamped to SUBDIVISION_MAX_DEPTH
+		const SubdivisionTemplate& GetTemplate(const unsigned int& depth);
+
+		// Subdivides triangles [first_triangle, first_triangle + number_of_triangles) on the calling thread
+		// Writes each triangle to its own place in the output, so ranges may run concurrently
+		static void SubdivideRange(
+			const SubdivisionTemplate& pattern,
+			const SubdivisionInput& input,
+			const unsigned int& first_triangle,
+			const unsigned int& number_of_triangles,
+			const SubdivisionOutput& output);
+
+		// Subdivides all triangles, split into ranges across the job system (see JobSystem::ParallelFor)
+		// Returns when every triangle is written
+		void Subdivide(
+			const unsigned int& depth,
+			const SubdivisionInput& input,
+			const unsigned int& number_of_triangles,
+			const SubdivisionOutput& output);
+		
+		// Builds the shared points and the index buffer of a triangle list, once per topology and depth
+		// The texture coordinates are static, so they are subdivided here
+		void BuildTopology(
+			const unsigned int& depth,
+			const unsigned short* triangle_indices,
+			const unsigned int& number_of_triangles,
+			const float* texture_coordinates,
+			SubdivisionTopology& topology);
+		
+		// Computes vertices [first_vertex, first_vertex + number_of_vertices) of the topology on the calling thread
+		static void SubdivideIndexedRange(
+			const SubdivisionTopology& topology,
+			const SubdivisionInput& input,
+			const unsigned int& first_vertex,
+			const unsigned int& number_of_vertices,
+			const SubdivisionOutput& output);
+		
+		// Computes every vertex of the topology, draw with topology.triangle_indices
+		// Split into ranges across the job system, returns when every vertex is written
+		void SubdivideIndexed(
+			const SubdivisionTopology& topology,
+			const SubdivisionInput& input,
+			const SubdivisionOutput& output);
+};
+
+// Number of vertices written for one triangle
+extern unsigned int SubdividedVertexCount(const unsigned int& depth);
+
+#endif
@@ -3,10 +3,14 @@
 
 #include "Process.hpp"
 #include "Colour.hpp"
+#include "Arena.hpp"
+#include "StateCache.hpp"
 
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <map>
 
 using namespace std;
 
@@ -18,11 +22,29 @@ using namespace std;
 #define VIDEO_WIDTH     (800)
 #define VIDEO_HEIGHT    (600)
 
+#define VIDEO_SUBDIVISION_THRESHOLD     (96.0f) // Pixels: projected height at which depth 1 starts, each further depth doubles it
+#define VIDEO_SUBDIVISION_HYSTERESIS    (0.2f)  // Fraction of a threshold to cross before the depth changes
+
+#define VIDEO_POSE_CACHE_STEPS  (16)    // Poses per keyframe pair: frame_interp is quantized to this for caching, 0 disables
+#define VIDEO_POSE_CACHE_MAX_STEPS (64) // Cycling the steps doubles them up to this, then disables the cache
+
+#define VIDEO_DEBUG_MAX_LINES   (65536) // Segments per frame: debug lines past this are dropped, see AddDebugLine
+#define VIDEO_DEBUG_MAX_STEP    (16)    // Vertices: sampling of debug vectors cycles 1, 2, 4, ... up to this
+
+#define VIDEO_VERTICAL_SYNC     (true)  // Swap on the display refresh by default, see SetVerticalSync
+
 #define X (0)
 #define Y (1)
 #define Z (2)
 #define W (3)
 
+enum MeshPath { // How models are shaded and drawn, see MD2Model::Render
+	MESH_INDEXED,       // Welded vertices, each shaded once, drawn with indices
+	MESH_STRIPS,        // GL command strips and fans
+	MESH_TRIANGLES,     // Independent triangles, every corner shaded
+	MESH_PATH_MAX
+};
+
 typedef void* (*TextureFilter)(
 	void* image,
 	const unsigned int& width,
@@ -34,20 +56,30 @@ extern TextureFilter TextureFilter_Toon;
 extern Colour GetPixel(void* image, const unsigned int& x, const unsigned int& y);
 extern void SetPixel(void* image, const unsigned int& x, const unsigned int& y, const Colour& pixel_colour);
 
-extern void Subdivide3D( // Warning: Recursive function
-	unsigned int depth,
-	vector<float>& buffer,
-	const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+struct TextureEntry {
+	
+	string path; // Canonical
+	TextureFilter filter;
+	
+	unsigned int width;
+	unsigned int height;
+	unsigned char bytes_per_pixel;
+	
+	int references;
+};
 
-extern void Subdivide2D( // Warning: Recursive function
-	unsigned int depth,
-	vector<float>& buffer,
-	const glm::vec2& a, const glm::vec2& b, const glm::vec2& c);
+typedef pair<string, TextureFilter> TextureKey;
 
 class Video : public System {
 	
 	private:
 		
+		// Shared textures, see LoadTexture
+		map<TextureKey, unsigned int> texture_ids;
+		map<unsigned int, TextureEntry> textures;
+		
+		unsigned int RegisterTexture(const unsigned int& texture_id, const TextureEntry& entry);
+		
 		//SDL_Window* window;
 		//SDL_GLContext context;
 		
@@ -64,13 +96,48 @@ class Video : public System {
 		
 		bool enable_interpolation;
 		bool enable_subdivision;
+		bool enable_indexed_subdivision;
 		bool enable_celshading;
 		bool enable_motion_blur;
+		bool enable_lighting_table;
+		bool enable_vertical_sync;
+		
+		unsigned int subdivision_depth; // See Subdivision, the most detail when adaptive
+		
+		// Adaptive subdivision, see SelectSubdivisionDepth
+		bool enable_adaptive_subdivision;
+		float subdivision_threshold;
+		float subdivision_hysteresis;
+		
+		unsigned int viewport_height; // Pixels, see Resize
 		
 		bool debug_lighting;
 		bool debug_normals;
 		bool debug_view;
 		
+		// Debug lines of the frame, world space, drawn at once by DrawDebugLines
+		vector<float> debug_line_vertices;  // 6 floats per segment: source, destination
+		vector<float> debug_line_colours;   // 6 floats per segment
+		unsigned int debug_lines_dropped;   // This frame, past VIDEO_DEBUG_MAX_LINES
+		bool debug_lines_were_dropped;      // Last frame, so dropping is logged when it starts
+		unsigned int debug_vector_step;     // Models queue vectors for every Nth vertex
+		
+		void DrawDebugLines();
+		
+		MeshPath mesh_path;
+		
+		unsigned int vertex_count; // Vertices shaded this frame, see CountVertices
+		
+		unsigned int pose_cache_steps;  // See GetPoseCacheSteps
+		unsigned int pose_cache_hits;   // This frame, see CountPose
+		unsigned int pose_cache_misses;
+		
+		unsigned int frame_number; // Frames drawn, see GetFrameNumber
+		
+		Arena frame_arena; // Reset at the end of every frame, see GetFrameArena
+		
+		StateCache state_cache; // Every state change goes through here, see GetStateCache
+		
 	protected:
 		
 		void Update(const unsigned int& elapsed_milliseconds);
@@ -84,13 +151,39 @@ class Video : public System {
 		
 		bool IsInterpolationEnabled() { return enable_interpolation; }
 		bool IsSubdivisionEnabled() { return enable_subdivision; }
+		bool IsIndexedSubdivisionEnabled() { return enable_indexed_subdivision; }
 		bool IsCelshadingEnabled() { return enable_celshading; }
 		bool IsMotionBlurEnabled() { return enable_motion_blur; }
+		bool IsLightingTableEnabled() { return enable_lighting_table; }
 		
 		void ToggleInterpolation() { enable_interpolation = !enable_interpolation; }
 		void ToggleSubdivision() { enable_subdivision = !enable_subdivision; }
+		void ToggleIndexedSubdivision();
 		void ToggleCelshading() { enable_celshading = !enable_celshading; }
 		void ToggleMotionBlur() { enable_motion_blur = !enable_motion_blur; }
+		void ToggleLightingTable() { enable_lighting_table = !enable_lighting_table; }
+		
+		// Vertical sync: swapping waits for the display refresh, which caps the frame rate without spinning
+		// Off if the driver does not support it (see ProcessManager::SetFrameLimit for a cap without it)
+		bool IsVerticalSyncEnabled() { return enable_vertical_sync; }
+		void SetVerticalSync(const bool& is_enabled);
+		void ToggleVerticalSync() { SetVerticalSync(!enable_vertical_sync); }
+		
+		unsigned int GetSubdivisionDepth() { return subdivision_depth; }
+		void SetSubdivisionDepth(const unsigned int& depth);
+		
+		bool IsAdaptiveSubdivisionEnabled() { return enable_adaptive_subdivision; }
+		void ToggleAdaptiveSubdivision();
+		
+		// Threshold: pixels, hysteresis: fraction of a threshold (0.0f to 1.0f)
+		void SetSubdivisionThreshold(const float& threshold, const float& hysteresis);
+		
+		// Pixels: height on screen of a sphere of radius at position (world space)
+		float GetProjectedSize(const glm::vec4& position, const float& radius);
+		
+		// Per instance: depth for the projected size, kept at previous_depth unless the size moves past a threshold
+		// Returns GetSubdivisionDepth unless adaptive
+		unsigned int SelectSubdivisionDepth(const float& projected_size, const unsigned int& previous_depth);
 		
 		bool IsDebuggingLighting() { return debug_lighting; }
 		bool IsDebuggingNormals() { return debug_normals; }
@@ -107,6 +200,42 @@ class Video : public System {
 			return false;
 		}
 		
+		// Queues a line segment (world space), drawn at the end of the frame
+		// Returns false once VIDEO_DEBUG_MAX_LINES segments are queued this frame
+		bool AddDebugLine(
+			const glm::vec4& source,
+			const glm::vec3& source_colour,
+			const glm::vec4& destination,
+			const glm::vec3& destination_colour);
+		
+		unsigned int GetDebugVectorStep() { return debug_vector_step; }
+		void CycleDebugVectorStep();
+		
+		// Per-frame vertex work: models count the vertices they interpolate and light, and the vertices they subdivide
+		void CountVertices(const unsigned int& count) { vertex_count += count; }
+		unsigned int GetVertexCount() { return vertex_count; }
+		
+		// Render buffers: valid until the end of the frame (the end of Update)
+		Arena* GetFrameArena() { return &frame_arena; }
+		
+		// Incremented when the frame arena is reset, so data from the arena can be tagged with it
+		unsigned int GetFrameNumber() { return frame_number; }
+		
+		// Interpolated poses are cached per model and frame, frame_interp quantized to this many steps (0: not cached)
+		unsigned int GetPoseCacheSteps() { return pose_cache_steps; }
+		void SetPoseCacheSteps(const unsigned int& steps);
+		void CyclePoseCacheSteps();
+		
+		void CountPose(const bool& hit) { if (hit) pose_cache_hits++; else pose_cache_misses++; }
+		unsigned int GetPoseCacheHits() { return pose_cache_hits; }
+		unsigned int GetPoseCacheMisses() { return pose_cache_misses; }
+		
+		// GL enable bits, client arrays, texture binds, line width and lights, render thread only
+		StateCache* GetStateCache() { return &state_cache; }
+		
+		MeshPath GetMeshPath() { return mesh_path; }
+		void ToggleMeshPath() { mesh_path = (MeshPath)((mesh_path + 1) % MESH_PATH_MAX); }
+		
 		glm::vec4 GetLightPosition();
 		glm::vec4 GetViewPosition();
 		
@@ -119,6 +248,12 @@ class Video : public System {
 		
 		bool IsTexture(const unsigned int& texture_id);
 		
+		/* Note:
+		 * Textures loaded from a path are shared and reference counted.
+		 * Loading the same canonical path with the same filter again returns the same texture_id,
+		 * the texture is deleted when every load has been matched by UnloadTexture.
+		 */
+		
 		// Return 0 on failure,
 		// Otherwise return a texture_id
 		unsigned int LoadTexture(
@@ -134,7 +269,35 @@ class Video : public System {
 			unsigned int& height,
 			unsigned char& bytes_per_pixel);
 		
+		/* Note:
+		 * LoadTexture is DecodeTexture followed by UploadTexture.
+		 * DecodeTexture does the file I/O and filtering and is safe to call from any thread.
+		 * UploadTexture needs the GL context and must be called from the render thread.
+		 */
+		
+		// Return NULL on failure,
+		// Otherwise return a decoded image for UploadTexture or FreeTexture
+		static void* DecodeTexture(
+			string const& path,
+			unsigned int& width,
+			unsigned int& height,
+			unsigned char& bytes_per_pixel,
+			TextureFilter filter);
+		
+		// Return 0 on failure,
+		// Otherwise return a texture_id
+		// The decoded image is always released
+		unsigned int UploadTexture(void* decoded_image);
+		
+		// As above, but shared with LoadTexture: if the texture is already loaded,
+		// the decoded image is released and the shared texture_id is returned
+		unsigned int UploadTexture(void* decoded_image, string const& path, TextureFilter filter);
+		
+		static void FreeTexture(void* decoded_image);
+		
 		void UnloadTexture(const unsigned int& texture_id);
+		
+		unsigned int GetTextureCount() { return textures.size(); }
 };
 
 #endif
@@ -0,0 +1,197 @@
+#include "Animator.hpp"
+#include "Animation.hpp"
+#include "Video.hpp" // VIDEO_FPS
+#include "Kernel.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include <SDL2/SDL.h> // SDL_GetPerformanceCounter
+
+// Batch of a ParallelFor, see Advance
+struct AnimatorBatch {
+	Animator*   animator;
+	float       elapsed_seconds;
+};
+
+static void AdvanceJob(void* data, const unsigned int& first_slot, const unsigned int& number_of_slots) {
+
+	AnimatorBatch* batch = (AnimatorBatch*)data;
+
+	batch->animator->AdvanceRange(batch->elapsed_seconds, first_slot, number_of_slots);
+}
+
+Animator::Animator(const string& name) : System(name), update_microseconds(0) {
+	SetFixedStep(true);
+}
+
+void Animator::Update(const unsigned int& elapsed_milliseconds) {
+
+	const Uint64 start = SDL_GetPerformanceCounter();
+
+	Advance((float)elapsed_milliseconds / 1000.0f);
+
+	update_microseconds = (unsigned int)((SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency());
+}
+
+unsigned int Animator::Insert(Animation* owner) {
+
+	const unsigned int slot = owners.size();
+
+	frames.push_back(0);
+	frame_interps.push_back(0.0f);
+	frame_rates.push_back(0.0f);
+	frame_counts.push_back(0);
+	loops.push_back(0);
+
+	previous_frames.push_back(0);
+	previous_frame_interps.push_back(0.0f);
+
+	owners.push_back(owner);
+
+	return slot;
+}
+
+void Animator::Remove(const unsigned int& slot) {
+
+	assert(slot < owners.size());
+
+	// Move the last instance into the slot...
+
+	const unsigned int last = owners.size() - 1;
+
+	if (slot != last) {
+
+		frames[slot]        = frames[last];
+		frame_interps[slot] = frame_interps[last];
+		frame_rates[slot]   = frame_rates[last];
+		frame_counts[slot]  = frame_counts[last];
+		loops[slot]         = loops[last];
+
+		previous_frames[slot]        = previous_frames[last];
+		previous_frame_interps[slot] = previous_frame_interps[last];
+
+		owners[slot] = owners[last];
+		owners[slot]->animator_slot = slot;
+	}
+
+	frames.pop_back();
+	frame_interps.pop_back();
+	frame_rates.pop_back();
+	frame_counts.pop_back();
+	loops.pop_back();
+
+	previous_frames.pop_back();
+	previous_frame_interps.pop_back();
+
+	owners.pop_back();
+}
+
+void Animator::SetFrame(const unsigned int& slot, const unsigned int& frame, const float& frame_interp) {
+	frames[slot] = frame;
+	frame_interps[slot] = frame_interp;
+
+	// A jump, not to be interpolated...
+
+	previous_frames[slot] = frame;
+	previous_frame_interps[slot] = frame_interp;
+}
+
+void Animator::GetRenderFrame(const unsigned int& slot, unsigned int& frame, float& frame_interp) {
+
+	const float alpha = engine.GetStepAlpha();
+
+	// Same frame: only the interp moved (past 1 when a finished action holds its last frame)...
+
+	if (frames[slot] == previous_frames[slot]) {
+		frame = frames[slot];
+		frame_interp = previous_frame_interps[slot] + alpha * (frame_interps[slot] - previous_frame_interps[slot]);
+		return;
+	}
+
+	// Next frame, or back to frame 0 when the action looped during the step...
+
+	const float previous_position = (float)previous_frames[slot] + previous_frame_interps[slot];
+
+	float position = (float)frames[slot] + frame_interps[slot];
+
+	if (position < previous_position) position += (float)frame_counts[slot];
+
+	position = previous_position + alpha * (position - previous_position);
+
+	frame = (unsigned int)position;
+	frame_interp = position - (float)frame;
+
+	if (frame >= frame_counts[slot]) frame -= frame_counts[slot];
+}
+
+unsigned int Animator::GetFrame(const unsigned int& slot) {
+
+	unsigned int frame;
+	float frame_interp;
+
+	GetRenderFrame(slot, frame, frame_interp);
+
+	return frame;
+}
+
+float Animator::GetFrameInterp(const unsigned int& slot) {
+
+	unsigned int frame;
+	float frame_interp;
+
+	GetRenderFrame(slot, frame, frame_interp);
+
+	return frame_interp;
+}
+
+void Animator::SetActionFrames(const unsigned int& slot, const unsigned int& number_of_frames, const bool& loop) {
+
+	// Each frame lasts 1 / VIDEO_FPS of the whole action...
+
+	frame_counts[slot] = number_of_frames;
+	frame_rates[slot] = (number_of_frames > 0) ? (float)VIDEO_FPS / (float)number_of_frames : 0.0f;
+	loops[slot] = loop ? 1 : 0;
+}
+
+void Animator::AdvanceRange(const float& elapsed_seconds, const unsigned int& first_slot, const unsigned int& number_of_slots) {
+
+	if (number_of_slots == 0) return;
+
+	PROFILE_ZONE("Animator::AdvanceRange");
+
+	assert(first_slot + number_of_slots <= owners.size());
+
+	// Keep the frames of this step, to interpolate from...
+
+	memcpy(&previous_frames[first_slot], &frames[first_slot], number_of_slots * sizeof(unsigned int));
+	memcpy(&previous_frame_interps[first_slot], &frame_interps[first_slot], number_of_slots * sizeof(float));
+
+	AdvanceFrames(
+		&frames[first_slot],
+		&frame_interps[first_slot],
+		&frame_rates[first_slot],
+		&frame_counts[first_slot],
+		&loops[first_slot],
+		elapsed_seconds,
+		number_of_slots);
+}
+
+void Animator::Advance(const float& elapsed_seconds) {
+
+	// Small batches cost less than jobs...
+
+	if (owners.size() < ANIMATOR_PARALLEL_SLOTS) {
+		AdvanceRange(elapsed_seconds, 0, owners.size());
+		return;
+	}
+
+	AnimatorBatch batch;
+
+	batch.animator = this;
+	batch.elapsed_seconds = elapsed_seconds;
+
+	SystemInstance<JobSystem>()->ParallelFor(AdvanceJob, &batch, owners.size(), ANIMATOR_RANGE_SLOTS);
+}
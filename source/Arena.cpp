@@ -0,0 +1,105 @@
+#include "Arena.hpp"
+
+#include <iostream>
+
+#include <cstdlib>
+
+using namespace std;
+
+static size_t AlignSize(const size_t& size) {
+	return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+Arena::Arena(const size_t& initial_size) :
+		block_used(0),
+		frame_used(0),
+		high_water_mark(0),
+		heap_allocations(0) {
+
+	AllocateBlock(AlignSize(initial_size));
+}
+
+Arena::~Arena() {
+	FreeBlocks();
+}
+
+bool Arena::AllocateBlock(const size_t& size) {
+
+	Block block;
+
+	block.size = size;
+
+	if (posix_memalign((void**)&block.data, ARENA_ALIGNMENT, size) != 0) {
+		cerr << "ERROR: Failed to allocate memory for arena!" << endl;
+		return false;
+	}
+
+	blocks.push_back(block);
+	block_used = 0;
+	heap_allocations++;
+
+	return true;
+}
+
+void Arena::FreeBlocks() {
+
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		free(blocks[i].data);
+	}
+
+	blocks.clear();
+	block_used = 0;
+}
+
+void* Arena::Allocate(const size_t& size) {
+
+	const size_t aligned_size = AlignSize(size);
+
+	if (blocks.empty() || blocks.back().size - block_used < aligned_size) {
+
+		// Chain a new block, at least twice the size of the last...
+
+		size_t block_size = blocks.empty() ? ARENA_BLOCK_SIZE : 2 * blocks.back().size;
+
+		if (block_size < aligned_size) block_size = aligned_size;
+
+		if (AllocateBlock(block_size) == false) return NULL;
+	}
+
+	void* span = blocks.back().data + block_used;
+
+	block_used += aligned_size;
+	frame_used += aligned_size;
+
+	if (high_water_mark < frame_used) high_water_mark = frame_used;
+
+	return span;
+}
+
+void Arena::Reset() {
+
+	// Coalesce, so the next frame fits in one block...
+
+	if (blocks.size() > 1) {
+
+		FreeBlocks();
+
+		if (AllocateBlock(high_water_mark)) {
+			cout << "Arena resized to high-water mark " << high_water_mark << endl;
+		}
+	}
+
+	block_used = 0;
+	frame_used = 0;
+}
+
+size_t Arena::GetCapacity() {
+
+	size_t capacity = 0;
+
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		capacity += blocks[i].size;
+	}
+
+	return capacity;
+}
@@ -7,6 +7,8 @@
 
 Audio::Audio(const std::string& name) : System(name) {
 	
+	SetTickRate(SYSTEM_TICK_NEVER); // Nothing to update, SDL_mixer plays on its own thread
+	
 	sound_count = 0;
 	music_count = 0;
 	
@@ -1,5 +1,8 @@
 #include "Input.hpp"
 #include "Video.hpp"
+#include "Registry.hpp"
+#include "Animator.hpp"
+#include "Profiler.hpp"
 
 #include <SDL2/SDL.h>
 
@@ -61,12 +64,54 @@ void Input::Update(const unsigned int& elapsed_milliseconds) {
 					
 					case SDLK_x: gfx->ToggleInterpolation(); break;
 					case SDLK_z: gfx->ToggleSubdivision(); break;
+					case SDLK_i: gfx->ToggleIndexedSubdivision(); break;
+					case SDLK_o: gfx->ToggleAdaptiveSubdivision(); break;
+					
+					case SDLK_1: gfx->SetSubdivisionDepth(1); break;
+					case SDLK_2: gfx->SetSubdivisionDepth(2); break;
+					case SDLK_3: gfx->SetSubdivisionDepth(3); break;
+					case SDLK_4: gfx->SetSubdivisionDepth(4); break;
 					case SDLK_c: gfx->ToggleCelshading(); break;
 					case SDLK_m: gfx->ToggleMotionBlur(); break;
+					case SDLK_t: gfx->ToggleLightingTable(); break;
+					case SDLK_p: gfx->CyclePoseCacheSteps(); break;
+					case SDLK_y: gfx->ToggleVerticalSync(); break;
+					case SDLK_f: engine.CycleFrameLimit(); break;
+					case SDLK_r: Profiler::Export(PROFILER_TRACE_PATH); break;
+					
+					case SDLK_g: {
+						
+						const char* mesh_paths[MESH_PATH_MAX] = {"Indexed", "Strips", "Triangles"};
+						
+						cout << mesh_paths[gfx->GetMeshPath()] << " vertices per frame " << gfx->GetVertexCount() << endl;
+						gfx->ToggleMeshPath();
+					} break;
+					
+					case SDLK_j: {
+						
+						StateCache* state = gfx->GetStateCache();
+						
+						cout << "GL state calls per frame " << state->GetIssuedCalls() << ", filtered " << state->GetFilteredCalls() << endl;
+						cout << "Pose cache hits per frame " << gfx->GetPoseCacheHits() << ", misses " << gfx->GetPoseCacheMisses() << endl;
+						
+						Animator* animator = SystemInstance<Animator>();
+						
+						cout << "Animated instances " << animator->GetInstanceCount() << ", advanced in " << animator->GetUpdateMicroseconds() << " us" << endl;
+					} break;
 
+					case SDLK_k: {
+						
+						SystemInstance<Registry>()->ReportMemory();
+						
+						Arena* arena = gfx->GetFrameArena();
+						
+						cout << "Frame arena high-water mark " << arena->GetHighWaterMark() << " bytes, capacity " << arena->GetCapacity() << " bytes, heap allocations " << arena->GetHeapAllocations() << endl;
+					} break;
+					
 					case SDLK_l: gfx->ToggleDebuggingLighting(); break;
 					case SDLK_n: gfx->ToggleDebuggingNormals(); break;
 					case SDLK_v: gfx->ToggleDebuggingView(); break;
+					case SDLK_b: gfx->CycleDebugVectorStep(); break;
 				}
 			} break;
 			
@@ -0,0 +1,419 @@
+#include "JobSystem.hpp"
+#include "Subdivision.hpp"
+#include "Profiler.hpp"
+
+#include <iostream>
+#include <algorithm>
+
+#include <cassert>
+#include <cstdlib>
+
+using namespace std;
+
+// The job system and queue of the calling thread, if it is a worker...
+
+static __thread JobSystem* worker_jobs = NULL;
+static __thread unsigned int worker_queue_index = 0;
+
+JobSystem::JobSystem(const string& name, const int& number_of_workers) : System(name) {
+
+	SetTickRate(SYSTEM_TICK_NEVER); // Only serves Run, Wait and ParallelFor
+
+	SDL_AtomicSet(&next_worker_index, 0);
+	SDL_AtomicSet(&queued_jobs, 0);
+	SDL_AtomicSet(&sleeping_workers, 0);
+	SDL_AtomicSet(&stopping, 0);
+
+	mutex = SDL_CreateMutex();
+	work_condition = SDL_CreateCond();
+
+	// The waiting threads run jobs too...
+
+	int worker_count = number_of_workers;
+
+	if (worker_count < 0) worker_count = SDL_GetCPUCount() - 1;
+
+	if (worker_count < 0) worker_count = 0;
+	if (worker_count > JOBS_MAX_WORKERS) worker_count = JOBS_MAX_WORKERS;
+
+	// Queues before workers, a worker may steal as soon as it starts...
+
+	for (int i = 0; i <= worker_count; i++) {
+		queues.push_back(new JobQueue());
+	}
+
+	for (int i = 0; i < worker_count; i++) {
+
+		SDL_Thread* worker = SDL_CreateThread(Work, "jobs", (void*)this);
+
+		if (worker == NULL) {
+			cerr << "ERROR: Failed to create job thread!" << endl;
+			cerr << SDL_GetError() << endl;
+			continue;
+		}
+
+		workers.push_back(worker);
+	}
+
+	cout << "Job workers " << workers.size() << endl;
+}
+
+JobSystem::~JobSystem() {
+
+	SDL_LockMutex(mutex);
+
+	SDL_AtomicSet(&stopping, 1);
+
+	SDL_CondBroadcast(work_condition);
+	SDL_UnlockMutex(mutex);
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		SDL_WaitThread(workers[i], NULL);
+	}
+
+	workers.clear();
+
+	for (unsigned int i = 0; i < queues.size(); i++) {
+		delete queues[i];
+	}
+
+	queues.clear();
+
+	SDL_DestroyCond(work_condition);
+	SDL_DestroyMutex(mutex);
+}
+
+int JobSystem::Work(void* data) {
+
+	JobSystem* jobs = (JobSystem*)data;
+
+	worker_jobs = jobs;
+	worker_queue_index = SDL_AtomicAdd(&jobs->next_worker_index, 1);
+
+	PROFILE_THREAD("jobs");
+
+	while (true) {
+
+		Job job;
+
+		if (jobs->Pop(worker_queue_index, job)) {
+			jobs->Execute(job);
+			continue;
+		}
+
+		if (SDL_AtomicGet(&jobs->stopping)) return 0;
+
+		// Spin a little, jobs often come in bursts (eg. ParallelFor)...
+
+		bool is_queued = false;
+
+		for (unsigned int i = 0; i < JOBS_SPINS && is_queued == false; i++) {
+			is_queued = (SDL_AtomicGet(&jobs->queued_jobs) > 0);
+		}
+
+		if (is_queued) continue;
+
+		// Sleep until jobs are queued...
+
+		SDL_LockMutex(jobs->mutex);
+
+		SDL_AtomicAdd(&jobs->sleeping_workers, 1);
+
+		while (SDL_AtomicGet(&jobs->queued_jobs) == 0 && SDL_AtomicGet(&jobs->stopping) == 0) {
+			SDL_CondWait(jobs->work_condition, jobs->mutex);
+		}
+
+		SDL_AtomicAdd(&jobs->sleeping_workers, -1);
+
+		SDL_UnlockMutex(jobs->mutex);
+	}
+
+	return 0;
+}
+
+unsigned int JobSystem::GetQueueIndex() {
+
+	if (worker_jobs == this) return worker_queue_index;
+
+	return queues.size() - 1; // Shared
+}
+
+void JobSystem::Push(const unsigned int& queue_index, const Job& job) {
+
+	JobQueue* queue = queues[queue_index];
+
+	SDL_AtomicLock(&queue->lock);
+
+	queue->jobs.push_back(job);
+	SDL_AtomicAdd(&queued_jobs, 1);
+
+	SDL_AtomicUnlock(&queue->lock);
+}
+
+void JobSystem::Wake() {
+
+	/* Note:
+	 * A worker counts itself as sleeping before it checks for queued jobs (under the mutex),
+	 * and jobs are counted before sleeping workers are checked here,
+	 * so either the worker sees the jobs, or it is woken.
+	 */
+
+	if (SDL_AtomicGet(&sleeping_workers) == 0) return;
+
+	SDL_LockMutex(mutex);
+	SDL_CondBroadcast(work_condition);
+	SDL_UnlockMutex(mutex);
+}
+
+bool JobSystem::Pop(const unsigned int& queue_index, Job& job) {
+
+	// Own queue: the most recent job...
+
+	JobQueue* queue = queues[queue_index];
+
+	SDL_AtomicLock(&queue->lock);
+
+	if (queue->jobs.empty() == false) {
+
+		job = queue->jobs.back();
+		queue->jobs.pop_back();
+		SDL_AtomicAdd(&queued_jobs, -1);
+
+		SDL_AtomicUnlock(&queue->lock);
+		return true;
+	}
+
+	SDL_AtomicUnlock(&queue->lock);
+
+	// Steal: the oldest job of the next queue with any...
+
+	for (unsigned int i = 1; i < queues.size(); i++) {
+
+		if (SDL_AtomicGet(&queued_jobs) == 0) return false;
+
+		JobQueue* victim = queues[(queue_index + i) % queues.size()];
+
+		SDL_AtomicLock(&victim->lock);
+
+		if (victim->jobs.empty() == false) {
+
+			job = victim->jobs.front();
+			victim->jobs.pop_front();
+			SDL_AtomicAdd(&queued_jobs, -1);
+
+			SDL_AtomicUnlock(&victim->lock);
+			return true;
+		}
+
+		SDL_AtomicUnlock(&victim->lock);
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const Job& job) {
+
+	job.function(job.data, job.first, job.count);
+
+	SDL_AtomicAdd(&job.counter->pending, -1); // Last: the waiting thread may return and free the data
+}
+
+void JobSystem::Run(JobFunction function, void* data, const unsigned int& first, const unsigned int& count, JobCounter& counter) {
+
+	Job job;
+
+	job.function = function;
+	job.data = data;
+	job.first = first;
+	job.count = count;
+	job.counter = &counter;
+
+	SDL_AtomicAdd(&counter.pending, 1);
+
+	Push(GetQueueIndex(), job);
+	Wake();
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+
+	const unsigned int queue_index = GetQueueIndex();
+
+	unsigned int spins = 0;
+
+	while (SDL_AtomicGet(&counter.pending) > 0) {
+
+		Job job;
+
+		if (Pop(queue_index, job)) {
+			Execute(job);
+			spins = 0;
+			continue;
+		}
+
+		// The last jobs are running on other threads...
+
+		if (++spins >= JOBS_SPINS) {
+			SDL_Delay(0); // Yield
+		}
+	}
+}
+
+void JobSystem::ParallelFor(JobFunction function, void* data, const unsigned int& count, const unsigned int& minimum_range) {
+
+	if (count == 0) return;
+
+	const unsigned int number_of_threads = workers.size() + 1;
+
+	unsigned int range = (count + JOBS_RANGES_PER_THREAD * number_of_threads - 1) / (JOBS_RANGES_PER_THREAD * number_of_threads);
+
+	if (range < minimum_range) range = minimum_range;
+
+	// One range costs less on the calling thread than a job...
+
+	if (workers.empty() || count <= range) {
+		function(data, 0, count);
+		return;
+	}
+
+	// Fork every range but the first, which the calling thread takes...
+
+	JobCounter counter;
+
+	const unsigned int queue_index = GetQueueIndex();
+
+	Job job;
+
+	job.function = function;
+	job.data = data;
+	job.counter = &counter;
+
+	for (unsigned int first = range; first < count; first += range) {
+
+		job.first = first;
+		job.count = (count - first < range) ? count - first : range;
+
+		SDL_AtomicAdd(&counter.pending, 1);
+
+		Push(queue_index, job);
+	}
+
+	Wake();
+
+	function(data, 0, range);
+
+	Wait(counter);
+}
+
+// ##### Benchmark...
+
+struct BenchmarkSubdivision {
+	const SubdivisionTemplate*  pattern;
+	SubdivisionInput            input;
+	SubdivisionOutput           output;
+};
+
+static void BenchmarkSubdivisionJob(void* data, const unsigned int& first, const unsigned int& count) {
+
+	BenchmarkSubdivision* benchmark = (BenchmarkSubdivision*)data;
+
+	Subdivision::SubdivideRange(*benchmark->pattern, benchmark->input, first, count, benchmark->output);
+}
+
+bool BenchmarkJobs() {
+
+	/* Note:
+	 * Subdivides a triangle list of the size of a large MD2 model at the deepest level,
+	 * as MD2Model::Render does, with 1 thread up to one per core.
+	 */
+
+	#define BENCHMARK_TRIANGLES     (4096)
+	#define BENCHMARK_REPEATS       (10)
+
+	const SubdivisionTemplate& pattern = SystemInstance<Subdivision>()->GetTemplate(SUBDIVISION_MAX_DEPTH);
+
+	const unsigned int number_of_corners = 3 * BENCHMARK_TRIANGLES;
+	const unsigned int number_of_vertices = BENCHMARK_TRIANGLES * pattern.number_of_vertices;
+
+	vector<unsigned short> triangle_indices(number_of_corners);
+	vector<float> corner_texture_coordinates(2 * number_of_corners);
+	vector<float> corner_attributes(3 * number_of_corners);
+
+	for (unsigned int i = 0; i < number_of_corners; i++) {
+		triangle_indices[i] = i;
+	}
+
+	for (unsigned int i = 0; i < corner_texture_coordinates.size(); i++) {
+		corner_texture_coordinates[i] = (float)rand() / RAND_MAX;
+	}
+
+	for (unsigned int i = 0; i < corner_attributes.size(); i++) {
+		corner_attributes[i] = 256.0f * ((float)rand() / RAND_MAX) - 128.0f;
+	}
+
+	BenchmarkSubdivision benchmark;
+
+	benchmark.pattern = &pattern;
+
+	benchmark.input.triangle_indices = &triangle_indices[0];
+	benchmark.input.texture_coordinates = &corner_texture_coordinates[0];
+	benchmark.input.colours = &corner_attributes[0];
+	benchmark.input.normals = &corner_attributes[0];
+	benchmark.input.vertices = &corner_attributes[0];
+
+	vector<float> texture_coordinates(2 * number_of_vertices);
+	vector<float> colours(3 * number_of_vertices);
+	vector<float> normals(3 * number_of_vertices);
+	vector<float> vertices(3 * number_of_vertices);
+
+	benchmark.output.texture_coordinates = &texture_coordinates[0];
+	benchmark.output.colours = &colours[0];
+	benchmark.output.normals = &normals[0];
+	benchmark.output.vertices = &vertices[0];
+
+	vector<float> expected;
+
+	int max_threads = SDL_GetCPUCount();
+
+	if (max_threads < 1) max_threads = 1;
+	if (max_threads > JOBS_MAX_WORKERS + 1) max_threads = JOBS_MAX_WORKERS + 1;
+
+	double single_thread_seconds = 0.0;
+
+	bool matched = true;
+
+	for (int threads = 1; threads <= max_threads; threads++) {
+
+		JobSystem jobs("benchmark", threads - 1);
+
+		fill(vertices.begin(), vertices.end(), 0.0f);
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+
+		for (unsigned int i = 0; i < BENCHMARK_REPEATS; i++) {
+			jobs.ParallelFor(BenchmarkSubdivisionJob, &benchmark, BENCHMARK_TRIANGLES, SUBDIVISION_RANGE_TRIANGLES);
+		}
+
+		const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency() / BENCHMARK_REPEATS;
+
+		// Compare with 1 thread...
+
+		if (threads == 1) {
+			expected = vertices;
+			single_thread_seconds = seconds;
+		}
+
+		const bool is_matched = (vertices == expected);
+
+		cout << "Jobs threads " << threads
+			<< " subdivision ms " << 1000.0 * seconds
+			<< " speedup " << ((seconds > 0.0) ? single_thread_seconds / seconds : 0.0)
+			<< (is_matched ? "" : " MISMATCH") << endl;
+
+		if (is_matched == false) {
+			cerr << "ERROR: Jobs with " << threads << " threads do not match 1 thread!" << endl;
+			matched = false;
+		}
+	}
+
+	return matched;
+}
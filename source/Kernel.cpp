@@ -0,0 +1,461 @@
+#include "Kernel.hpp"
+#include "MD2.hpp"
+
+#include <iostream>
+
+#include <cassert>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <SDL2/SDL.h> // SDL_GetPerformanceCounter
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define KERNEL_X86
+	#include <emmintrin.h>
+	#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// ##### Interpolate...
+
+static void InterpolateScalar(const float* a, const float* b, const float& t, float* result, const unsigned int& count) {
+
+	for (unsigned int i = 0; i < count; i++) {
+		result[i] = a[i] + t * (b[i] - a[i]);
+	}
+}
+
+#ifdef KERNEL_X86
+
+static void InterpolateSSE2(const float* a, const float* b, const float& t, float* result, const unsigned int& count) {
+
+	const __m128 T = _mm_set1_ps(t);
+
+	for (unsigned int i = 0; i < count; i += 8) { // Two registers per iteration...
+
+		const __m128 a0 = _mm_load_ps(a + i);
+		const __m128 a1 = _mm_load_ps(a + i + 4);
+
+		const __m128 b0 = _mm_load_ps(b + i);
+		const __m128 b1 = _mm_load_ps(b + i + 4);
+
+		_mm_store_ps(result + i,     _mm_add_ps(a0, _mm_mul_ps(T, _mm_sub_ps(b0, a0))));
+		_mm_store_ps(result + i + 4, _mm_add_ps(a1, _mm_mul_ps(T, _mm_sub_ps(b1, a1))));
+	}
+}
+
+__attribute__((target("avx2")))
+static void InterpolateAVX2(const float* a, const float* b, const float& t, float* result, const unsigned int& count) {
+
+	const __m256 T = _mm256_set1_ps(t);
+
+	unsigned int i = 0;
+
+	for (; i + 16 <= count; i += 16) { // Two registers per iteration...
+
+		const __m256 a0 = _mm256_load_ps(a + i);
+		const __m256 a1 = _mm256_load_ps(a + i + 8);
+
+		const __m256 b0 = _mm256_load_ps(b + i);
+		const __m256 b1 = _mm256_load_ps(b + i + 8);
+
+		_mm256_store_ps(result + i,     _mm256_add_ps(a0, _mm256_mul_ps(T, _mm256_sub_ps(b0, a0))));
+		_mm256_store_ps(result + i + 8, _mm256_add_ps(a1, _mm256_mul_ps(T, _mm256_sub_ps(b1, a1))));
+	}
+
+	for (; i < count; i += 8) { // Odd multiple of KERNEL_WIDTH...
+
+		const __m256 a0 = _mm256_load_ps(a + i);
+		const __m256 b0 = _mm256_load_ps(b + i);
+
+		_mm256_store_ps(result + i, _mm256_add_ps(a0, _mm256_mul_ps(T, _mm256_sub_ps(b0, a0))));
+	}
+}
+
+#endif
+
+// ##### Advance frames...
+
+static void AdvanceFramesScalar(
+		unsigned int* frames,
+		float* frame_interps,
+		const float* frame_rates,
+		const unsigned int* frame_counts,
+		const unsigned int* loops,
+		const float& elapsed_seconds,
+		const unsigned int& count) {
+
+	for (unsigned int i = 0; i < count; i++) {
+
+		const float next_frame_interp = frame_interps[i] + elapsed_seconds * frame_rates[i];
+
+		if (next_frame_interp < 1.0f) {
+			frame_interps[i] = next_frame_interp;
+			continue;
+		}
+
+		const unsigned int next_frame = frames[i] + 1;
+
+		if (next_frame < frame_counts[i]) {
+			frames[i] = next_frame;
+			frame_interps[i] = 0.0f;
+			continue;
+		}
+
+		if (loops[i]) {
+			frames[i] = 0;
+			frame_interps[i] = 0.0f;
+		}
+	}
+}
+
+#ifdef KERNEL_X86
+
+/* Note:
+ * Branches become masks (all bits set where true), blended per lane:
+ *   done frame  = (has next frame & next frame) | (held & frame)   ie. 0 when restarted
+ *   done interp = held & interp                                    ie. 0.0f unless held
+ * Frame counts are compared as signed integers (a few hundred frames at most).
+ */
+
+static void AdvanceFramesSSE2(
+		unsigned int* frames,
+		float* frame_interps,
+		const float* frame_rates,
+		const unsigned int* frame_counts,
+		const unsigned int* loops,
+		const float& elapsed_seconds,
+		const unsigned int& count) {
+
+	const __m128 S = _mm_set1_ps(elapsed_seconds);
+	const __m128 ONE = _mm_set1_ps(1.0f);
+	const __m128i ONE_FRAME = _mm_set1_epi32(1);
+	const __m128i ZERO = _mm_setzero_si128();
+
+	unsigned int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+
+		const __m128 interp = _mm_loadu_ps(frame_interps + i);
+		const __m128i frame = _mm_loadu_si128((const __m128i*)(frames + i));
+
+		const __m128 next_interp = _mm_add_ps(interp, _mm_mul_ps(S, _mm_loadu_ps(frame_rates + i)));
+		const __m128i next_frame = _mm_add_epi32(frame, ONE_FRAME);
+
+		const __m128 done = _mm_cmpge_ps(next_interp, ONE);
+		const __m128i has_next = _mm_cmplt_epi32(next_frame, _mm_loadu_si128((const __m128i*)(frame_counts + i)));
+		const __m128i held = _mm_andnot_si128(has_next, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(loops + i)), ZERO));
+
+		const __m128i done_frame = _mm_or_si128(_mm_and_si128(has_next, next_frame), _mm_and_si128(held, frame));
+		const __m128 done_interp = _mm_and_ps(_mm_castsi128_ps(held), interp);
+
+		const __m128i done_mask = _mm_castps_si128(done);
+
+		_mm_storeu_si128((__m128i*)(frames + i), _mm_or_si128(_mm_andnot_si128(done_mask, frame), _mm_and_si128(done_mask, done_frame)));
+		_mm_storeu_ps(frame_interps + i, _mm_or_ps(_mm_andnot_ps(done, next_interp), _mm_and_ps(done, done_interp)));
+	}
+
+	AdvanceFramesScalar(frames + i, frame_interps + i, frame_rates + i, frame_counts + i, loops + i, elapsed_seconds, count - i);
+}
+
+__attribute__((target("avx2")))
+static void AdvanceFramesAVX2(
+		unsigned int* frames,
+		float* frame_interps,
+		const float* frame_rates,
+		const unsigned int* frame_counts,
+		const unsigned int* loops,
+		const float& elapsed_seconds,
+		const unsigned int& count) {
+
+	const __m256 S = _mm256_set1_ps(elapsed_seconds);
+	const __m256 ONE = _mm256_set1_ps(1.0f);
+	const __m256i ONE_FRAME = _mm256_set1_epi32(1);
+	const __m256i ZERO = _mm256_setzero_si256();
+
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+
+		const __m256 interp = _mm256_loadu_ps(frame_interps + i);
+		const __m256i frame = _mm256_loadu_si256((const __m256i*)(frames + i));
+
+		const __m256 next_interp = _mm256_add_ps(interp, _mm256_mul_ps(S, _mm256_loadu_ps(frame_rates + i)));
+		const __m256i next_frame = _mm256_add_epi32(frame, ONE_FRAME);
+
+		const __m256 done = _mm256_cmp_ps(next_interp, ONE, _CMP_GE_OQ);
+		const __m256i has_next = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(frame_counts + i)), next_frame);
+		const __m256i held = _mm256_andnot_si256(has_next, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(loops + i)), ZERO));
+
+		const __m256i done_frame = _mm256_or_si256(_mm256_and_si256(has_next, next_frame), _mm256_and_si256(held, frame));
+		const __m256 done_interp = _mm256_and_ps(_mm256_castsi256_ps(held), interp);
+
+		_mm256_storeu_si256((__m256i*)(frames + i), _mm256_blendv_epi8(frame, done_frame, _mm256_castps_si256(done)));
+		_mm256_storeu_ps(frame_interps + i, _mm256_blendv_ps(next_interp, done_interp, done));
+	}
+
+	AdvanceFramesSSE2(frames + i, frame_interps + i, frame_rates + i, frame_counts + i, loops + i, elapsed_seconds, count - i);
+}
+
+#endif
+
+// ##### Dispatch...
+
+typedef void (*InterpolateKernel)(const float* a, const float* b, const float& t, float* result, const unsigned int& count);
+
+static InterpolateKernel interpolate_kernels[KERNEL_LEVEL_MAX] = {
+	InterpolateScalar,
+#ifdef KERNEL_X86
+	InterpolateSSE2,
+	InterpolateAVX2
+#else
+	InterpolateScalar,
+	InterpolateScalar
+#endif
+};
+
+typedef void (*AdvanceFramesKernel)(
+	unsigned int* frames,
+	float* frame_interps,
+	const float* frame_rates,
+	const unsigned int* frame_counts,
+	const unsigned int* loops,
+	const float& elapsed_seconds,
+	const unsigned int& count);
+
+static AdvanceFramesKernel advance_frames_kernels[KERNEL_LEVEL_MAX] = {
+	AdvanceFramesScalar,
+#ifdef KERNEL_X86
+	AdvanceFramesSSE2,
+	AdvanceFramesAVX2
+#else
+	AdvanceFramesScalar,
+	AdvanceFramesScalar
+#endif
+};
+
+static KernelLevel kernel_level = GetSupportedKernelLevel();
+
+KernelLevel GetSupportedKernelLevel() {
+
+#ifdef KERNEL_X86
+
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+	if (__builtin_cpu_supports("sse2")) return KERNEL_SSE2;
+
+#endif
+
+	return KERNEL_SCALAR;
+}
+
+KernelLevel GetKernelLevel() {
+	return kernel_level;
+}
+
+bool SetKernelLevel(const KernelLevel& level) {
+
+	if (GetSupportedKernelLevel() < level) return false;
+
+	kernel_level = level;
+
+	return true;
+}
+
+string KernelLevelToString(const KernelLevel& level) {
+
+	if (level == KERNEL_SCALAR) return "Scalar";
+	if (level == KERNEL_SSE2)   return "SSE2";
+	if (level == KERNEL_AVX2)   return "AVX2";
+
+	return "INVALID";
+}
+
+void Interpolate(const float* a, const float* b, const float& t, float* result, const unsigned int& count) {
+
+	assert((count % KERNEL_WIDTH) == 0);
+	assert(((size_t)a % KERNEL_ALIGNMENT) == 0);
+	assert(((size_t)b % KERNEL_ALIGNMENT) == 0);
+	assert(((size_t)result % KERNEL_ALIGNMENT) == 0);
+
+	interpolate_kernels[kernel_level](a, b, t, result, count);
+}
+
+void AdvanceFrames(
+		unsigned int* frames,
+		float* frame_interps,
+		const float* frame_rates,
+		const unsigned int* frame_counts,
+		const unsigned int* loops,
+		const float& elapsed_seconds,
+		const unsigned int& count) {
+
+	advance_frames_kernels[kernel_level](frames, frame_interps, frame_rates, frame_counts, loops, elapsed_seconds, count);
+}
+
+// ##### Benchmark...
+
+static bool BenchmarkAdvanceFrames() {
+
+	/* Note:
+	 * Advances many animations with varied actions for a number of ticks,
+	 * as Animator::Update does every tick. Every level starts from the same state.
+	 */
+
+	#define BENCHMARK_ANIMATIONS    (100000)
+	#define BENCHMARK_TICKS         (1000)
+
+	const unsigned int count = BENCHMARK_ANIMATIONS;
+
+	vector<unsigned int> initial_frames(count);
+	vector<float> frame_rates(count);
+	vector<unsigned int> frame_counts(count);
+	vector<unsigned int> loops(count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		frame_counts[i] = 1 + rand() % 40;
+		frame_rates[i] = 48.0f / (float)frame_counts[i];
+		initial_frames[i] = rand() % frame_counts[i];
+		loops[i] = rand() & 1;
+	}
+
+	vector<unsigned int> expected_frames(initial_frames);
+	vector<float> expected_interps(count, 0.0f);
+
+	for (unsigned int tick = 0; tick < BENCHMARK_TICKS; tick++) {
+		AdvanceFramesScalar(&expected_frames[0], &expected_interps[0], &frame_rates[0], &frame_counts[0], &loops[0], 0.001f * (float)(1 + tick % 33), count);
+	}
+
+	const KernelLevel previous_level = GetKernelLevel();
+
+	bool matched = true;
+
+	for (int level = KERNEL_SCALAR; level <= GetSupportedKernelLevel(); level++) {
+
+		SetKernelLevel((KernelLevel)level);
+
+		vector<unsigned int> frames(initial_frames);
+		vector<float> frame_interps(count, 0.0f);
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+
+		for (unsigned int tick = 0; tick < BENCHMARK_TICKS; tick++) {
+			AdvanceFrames(&frames[0], &frame_interps[0], &frame_rates[0], &frame_counts[0], &loops[0], 0.001f * (float)(1 + tick % 33), count);
+		}
+
+		const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+		const double animations_per_second = (seconds > 0.0) ? (double)count * BENCHMARK_TICKS / seconds : 0.0;
+
+		unsigned int mismatches = 0;
+
+		for (unsigned int i = 0; i < count; i++) {
+			if (frames[i] != expected_frames[i] || frame_interps[i] != expected_interps[i]) mismatches++;
+		}
+
+		cout << "Kernel " << KernelLevelToString((KernelLevel)level)
+			<< " animations per second " << animations_per_second
+			<< " mismatches " << mismatches << endl;
+
+		if (mismatches > 0) {
+			cerr << "ERROR: Kernel " << KernelLevelToString((KernelLevel)level) << " does not match scalar kernel!" << endl;
+			matched = false;
+		}
+	}
+
+	SetKernelLevel(previous_level);
+
+	return matched;
+}
+
+bool BenchmarkKernels() {
+
+	/* Note:
+	 * Interpolates two keyframes of the largest MD2 model (positions and normals),
+	 * as MD2Model::Render does for each model every frame.
+	 */
+
+	#define BENCHMARK_ITERATIONS (20000)
+
+	const unsigned int number_of_vertices = MD2_MAX_VERTICES;
+	const unsigned int count = 6 * number_of_vertices; // x, y, z, nx, ny, nz
+
+	float* buffers[4] = {NULL, NULL, NULL, NULL};
+
+	for (unsigned int i = 0; i < 4; i++) {
+		if (posix_memalign((void**)&buffers[i], KERNEL_ALIGNMENT, count * sizeof(float)) != 0) {
+			cerr << "ERROR: Failed to allocate memory for benchmark!" << endl;
+			for (unsigned int j = 0; j < i; j++) free(buffers[j]);
+			return false;
+		}
+	}
+
+	float* a = buffers[0];
+	float* b = buffers[1];
+	float* expected = buffers[2];
+	float* result = buffers[3];
+
+	for (unsigned int i = 0; i < count; i++) {
+		a[i] = 256.0f * ((float)rand() / RAND_MAX) - 128.0f;
+		b[i] = 256.0f * ((float)rand() / RAND_MAX) - 128.0f;
+	}
+
+	const float t = 0.375f;
+
+	InterpolateScalar(a, b, t, expected, count);
+
+	const KernelLevel previous_level = GetKernelLevel();
+
+	bool matched = true;
+
+	for (int level = KERNEL_SCALAR; level <= GetSupportedKernelLevel(); level++) {
+
+		SetKernelLevel((KernelLevel)level);
+
+		// Compare with the scalar kernel...
+
+		Interpolate(a, b, t, result, count);
+
+		float error = 0.0f;
+
+		for (unsigned int i = 0; i < count; i++) {
+			error = max(error, (float)fabs(result[i] - expected[i]));
+		}
+
+		// Time...
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+
+		for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+			Interpolate(a, b, t + (float)(i & 1) * 0.25f, result, count);
+		}
+
+		const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+		const double vertices_per_second = (seconds > 0.0) ? (double)number_of_vertices * BENCHMARK_ITERATIONS / seconds : 0.0;
+
+		cout << "Kernel " << KernelLevelToString((KernelLevel)level)
+			<< " vertices per second " << vertices_per_second
+			<< " max error " << error << endl;
+
+		if (KERNEL_TOLERANCE < error) {
+			cerr << "ERROR: Kernel " << KernelLevelToString((KernelLevel)level) << " does not match scalar kernel!" << endl;
+			matched = false;
+		}
+	}
+
+	SetKernelLevel(previous_level);
+
+	for (unsigned int i = 0; i < 4; i++) {
+		free(buffers[i]);
+	}
+
+	if (BenchmarkAdvanceFrames() == false) {
+		matched = false;
+	}
+
+	return matched;
+}
@@ -0,0 +1,344 @@
+#include "Loader.hpp"
+#include "Video.hpp"
+#include "MD2.hpp"
+#include "Profiler.hpp"
+
+#include <iostream>
+#include <cassert>
+
+// ##### Jobs...
+
+class AnimationInfoJob : public LoadResult<AnimationInfo> {
+
+	private:
+
+		const string act_path;
+
+	protected:
+
+		bool Load() {
+			result = AnimationInfo(act_path);
+			return result.IsLoaded();
+		}
+
+	public:
+
+		AnimationInfoJob(const string& act_path) : act_path(act_path) {}
+};
+
+class ModelJob : public LoadResult<AnimationModel*> {
+
+	private:
+
+		MD2Model* model;
+
+	protected:
+
+		bool Load() { return model->Load(); }
+		bool Upload() { return model->Upload(); }
+
+	public:
+
+		ModelJob(MD2Model* model) : model(model) {
+			result = model;
+		}
+};
+
+class TextureJob : public LoadResult<unsigned int> {
+
+	private:
+
+		const string path;
+		TextureFilter filter;
+
+		void* image; // Decoded, waiting for upload
+
+	protected:
+
+		bool Load() {
+
+			unsigned int width;
+			unsigned int height;
+			unsigned char bytes_per_pixel;
+
+			image = Video::DecodeTexture(path, width, height, bytes_per_pixel, filter);
+
+			return (image != NULL);
+		}
+
+		bool Upload() {
+
+			result = SystemInstance<Video>()->UploadTexture(image);
+			image = NULL; // Released by UploadTexture
+
+			return (result != 0);
+		}
+
+	public:
+
+		TextureJob(const string& path, TextureFilter filter)
+			: path(path)
+			, filter(filter)
+			, image(NULL) {
+
+			result = 0;
+		}
+
+		~TextureJob() {
+			Video::FreeTexture(image);
+		}
+};
+
+// ##### LoadJob...
+
+LoadJob::LoadJob() : loader(NULL) {
+	SDL_AtomicSet(&state, LOAD_PENDING);
+	SDL_AtomicSet(&references, 0);
+}
+
+void LoadJob::Retain() {
+	SDL_AtomicIncRef(&references);
+}
+
+void LoadJob::Release() {
+	if (SDL_AtomicDecRef(&references)) {
+		delete this;
+	}
+}
+
+void LoadJob::Wait() {
+
+	assert(loader != NULL);
+
+	while (IsDone() == false) {
+
+		// Upload on this (render) thread, including this job once it is loaded...
+
+		if (loader->UploadLoadedJobs()) continue;
+
+		SDL_LockMutex(loader->mutex);
+
+		if (IsDone() == false && loader->loaded_jobs.empty()) {
+			SDL_CondWaitTimeout(loader->loaded_condition, loader->mutex, 10);
+		}
+
+		SDL_UnlockMutex(loader->mutex);
+	}
+}
+
+// ##### Loader...
+
+Loader::Loader(const string& name) : System(name), stopping(false) {
+
+	SetTickRate(LOADER_TICK_RATE);
+
+	SDL_AtomicSet(&active_jobs, 0);
+
+	mutex = SDL_CreateMutex();
+	pending_condition = SDL_CreateCond();
+	loaded_condition = SDL_CreateCond();
+
+	// Leave a core for the render thread...
+
+	int worker_count = SDL_GetCPUCount() - 1;
+
+	if (worker_count < 1) worker_count = 1;
+	if (worker_count > LOADER_MAX_WORKERS) worker_count = LOADER_MAX_WORKERS;
+
+	for (int i = 0; i < worker_count; i++) {
+
+		SDL_Thread* worker = SDL_CreateThread(Work, "loader", (void*)this);
+
+		if (worker == NULL) {
+			cerr << "ERROR: Failed to create loader thread!" << endl;
+			cerr << SDL_GetError() << endl;
+			continue;
+		}
+
+		workers.push_back(worker);
+	}
+
+	cout << "Loader workers " << workers.size() << endl;
+}
+
+Loader::~Loader() {
+
+	// Abandon pending jobs and stop the workers...
+
+	SDL_LockMutex(mutex);
+
+	stopping = true;
+
+	deque<LoadJob*> abandoned_jobs;
+	abandoned_jobs.swap(pending_jobs);
+
+	SDL_CondBroadcast(pending_condition);
+	SDL_UnlockMutex(mutex);
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		SDL_WaitThread(workers[i], NULL);
+	}
+
+	workers.clear();
+
+	abandoned_jobs.insert(abandoned_jobs.end(), loaded_jobs.begin(), loaded_jobs.end());
+	loaded_jobs.clear();
+
+	for (unsigned int i = 0; i < abandoned_jobs.size(); i++) {
+		SDL_AtomicSet(&(abandoned_jobs[i]->state), LOAD_FAILED);
+		SDL_AtomicDecRef(&active_jobs);
+		abandoned_jobs[i]->Release();
+	}
+
+	SDL_DestroyCond(loaded_condition);
+	SDL_DestroyCond(pending_condition);
+	SDL_DestroyMutex(mutex);
+}
+
+int Loader::Work(void* data) {
+
+	Loader* loader = (Loader*)data;
+
+	PROFILE_THREAD("loader");
+
+	while (true) {
+
+		SDL_LockMutex(loader->mutex);
+
+		while (loader->pending_jobs.empty() && loader->stopping == false) {
+			SDL_CondWait(loader->pending_condition, loader->mutex);
+		}
+
+		if (loader->stopping) {
+			SDL_UnlockMutex(loader->mutex);
+			return 0;
+		}
+
+		LoadJob* job = loader->pending_jobs.front();
+		loader->pending_jobs.pop_front();
+
+		SDL_UnlockMutex(loader->mutex);
+
+		PROFILE_ZONE("LoadJob::Load");
+
+		loader->Finish(job, job->Load());
+	}
+
+	return 0;
+}
+
+void Loader::Queue(LoadJob* job) {
+
+	job->loader = this;
+	job->Retain(); // Released once uploaded or failed
+
+	SDL_AtomicIncRef(&active_jobs);
+
+	SDL_LockMutex(mutex);
+
+	pending_jobs.push_back(job);
+
+	SDL_CondSignal(pending_condition);
+	SDL_UnlockMutex(mutex);
+}
+
+void Loader::Finish(LoadJob* job, const bool& loaded) {
+
+	SDL_LockMutex(mutex);
+
+	if (loaded) {
+		SDL_AtomicSet(&(job->state), LOAD_LOADED);
+		loaded_jobs.push_back(job);
+	}
+	else {
+		SDL_AtomicSet(&(job->state), LOAD_FAILED);
+	}
+
+	SDL_CondBroadcast(loaded_condition);
+	SDL_UnlockMutex(mutex);
+
+	if (loaded == false) {
+		SDL_AtomicDecRef(&active_jobs);
+		job->Release();
+	}
+}
+
+bool Loader::UploadLoadedJobs() {
+
+	SDL_LockMutex(mutex);
+
+	deque<LoadJob*> upload_jobs;
+	upload_jobs.swap(loaded_jobs);
+
+	SDL_UnlockMutex(mutex);
+
+	for (unsigned int i = 0; i < upload_jobs.size(); i++) {
+
+		LoadJob* job = upload_jobs[i];
+
+		PROFILE_ZONE("LoadJob::Upload");
+
+		const bool uploaded = job->Upload();
+
+		SDL_AtomicSet(&(job->state), uploaded ? LOAD_READY : LOAD_FAILED);
+		SDL_AtomicDecRef(&active_jobs);
+
+		job->Release();
+	}
+
+	return (upload_jobs.empty() == false);
+}
+
+void Loader::Update(const unsigned int&) {
+
+	/* Note:
+	 * Only the GL upload is done on the render thread.
+	 * Everything else was done by the workers.
+	 */
+
+	UploadLoadedJobs();
+}
+
+LoadHandle<AnimationInfo> Loader::LoadAnimationInfo(const string& act_path) {
+
+	LoadResult<AnimationInfo>* job = new AnimationInfoJob(act_path);
+	LoadHandle<AnimationInfo> handle(job);
+
+	Queue(job);
+
+	return handle;
+}
+
+LoadHandle<AnimationModel*> Loader::LoadModel(const string& act_path, const ModelLoadMode& load_mode, const KeyframeStorage& keyframe_storage) {
+
+	LoadResult<AnimationModel*>* job = new ModelJob(new MD2Model(act_path, load_mode, true, keyframe_storage));
+	LoadHandle<AnimationModel*> handle(job);
+
+	Queue(job);
+
+	return handle;
+}
+
+LoadHandle<AnimationModel*> Loader::LoadModel(const AnimationInfo& animation_info, const ModelLoadMode& load_mode, const KeyframeStorage& keyframe_storage) {
+
+	LoadResult<AnimationModel*>* job = new ModelJob(new MD2Model(animation_info, load_mode, true, keyframe_storage));
+	LoadHandle<AnimationModel*> handle(job);
+
+	Queue(job);
+
+	return handle;
+}
+
+LoadHandle<unsigned int> Loader::LoadTexture(const string& path, TextureFilter filter) {
+
+	LoadResult<unsigned int>* job = new TextureJob(path, filter);
+	LoadHandle<unsigned int> handle(job);
+
+	Queue(job);
+
+	return handle;
+}
+
+unsigned int Loader::GetPendingCount() {
+	return SDL_AtomicGet(&active_jobs);
+}
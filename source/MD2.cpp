@@ -1,8 +1,12 @@
 #include "MD2.hpp"
 #include "Process.hpp"
 #include "Misc.hpp"
+#include "Kernel.hpp"
+#include "Subdivision.hpp"
+#include "Profiler.hpp"
 
 #include <GL/gl.h>
+#include <SDL2/SDL.h> // SDL_GetTicks
 
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,6 +17,12 @@
 #include <vector>
 
 #include <cassert>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -28,104 +38,170 @@ using namespace std;
 	]                               @endOfFileOffset
  */
 
-void MD2Model::LoadModel(const string& md2_path) {
-	
-	fstream md2_file(md2_path.c_str(), fstream::in | fstream::binary);
-
-	if (md2_file.good() == false) {
-		cerr << "ERROR: MD2 file failed to load!" << endl;
-		engine.Stop();
-		return;
-	}
-	
-	// Get file size in bytes...
-
-	unsigned int md2_file_size;
-
-	md2_file.seekg(0, md2_file.end);
-	md2_file_size = md2_file.tellg();
-
-	cout << "File Size " << md2_file_size << endl;
-
-	md2_file.seekg(0, md2_file.beg); // Reset file handle
-	md2_file.clear(); // Reset file flags
-
-	// Read header...
-
-	unsigned int md2_header_size = sizeof(md2::Header);
-
-	if (md2_file_size < md2_header_size) {
-		cerr << "ERROR: File is smaller than header size!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
-	}
-
-	md2_file.read((char*)&header, md2_header_size);
+bool MD2Model::ValidateHeader(const size_t& md2_file_size) {
 	
 	// Validate header...
 
-	cout << "Identity " << header.identity << endl;
+	cout << "Identity " << string(header.identity, sizeof_member(md2::Header, identity)) << endl;
 
-	if (string(header.identity) == MD2_IDENTITY) {
+	if (strncmp(header.identity, MD2_IDENTITY, sizeof_member(md2::Header, identity)) != 0) {
 		cerr << "ERROR: Invalid header identity!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
 	}
 
 	cout << "Version " << header.version << endl;
 	
 	if (header.version != MD2_VERSION) {
 		cerr << "ERROR: Invalid header version!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
 	}
 
 	cout << "Number of Skins " << header.numberOfSkins << endl;
 	
 	if (MD2_MAX_SKINS < header.numberOfSkins) {
 		cerr << "ERROR: Number of skins exceeds maximum!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
 	}
 
 	cout << "Number of Vertices " << header.numberOfVertices << endl;
 	
 	if (MD2_MAX_VERTICES < header.numberOfVertices) {
 		cerr << "ERROR: Number of vertices exceeds maximum!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
 	}
 
 	cout << "Number of Texture Coordinates " << header.numberOfTextureCoordinates << endl;
 	
 	if (MD2_MAX_TEXTURE_COORDINATES < header.numberOfTextureCoordinates) {
 		cerr << "ERROR: Number of texture coordinates exceeds maximum!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
 	}
 
 	cout << "Number of Triangles " << header.numberOfTriangles << endl;
 	
 	if (MD2_MAX_TRIANGLES < header.numberOfTriangles) {
 		cerr << "ERROR: Number of triangles exceeds maximum!" << endl;
-		md2_file.close();
-		engine.Stop();
-		return;
+		return false;
+	}
+
+	if (MD2_MAX_GL_COMMANDS < header.numberOfGraphicCommands) {
+		cerr << "ERROR: Number of GL commands exceeds maximum!" << endl;
+		return false;
 	}
 
 	cout << "Number of Frames " << header.numberOfFrames << endl;
 	
 	if (MD2_MAX_FRAMES < header.numberOfFrames) {
 		cerr << "ERROR: Number of frames exceeds maximum!" << endl;
+		return false;
+	}
+	
+	// Validate sections against the file size...
+	
+	/* Note:
+	 * Every section is checked once here so that readers
+	 * (and pointers into a file mapping) never leave the file.
+	 */
+	
+	if (header.numberOfSkins < 0 ||
+		header.numberOfVertices < 0 ||
+		header.numberOfTextureCoordinates < 0 ||
+		header.numberOfTriangles < 0 ||
+		header.numberOfGraphicCommands < 0 ||
+		header.numberOfFrames < 0) {
+		
+		cerr << "ERROR: Negative section size!" << endl;
+		return false;
+	}
+	
+	if (IsSectionInFile(header.textureCoordinateOffset,
+			(size_t)header.numberOfTextureCoordinates * sizeof(md2::TextureCoordinate), md2_file_size) == false) {
+		cerr << "ERROR: Texture coordinates exceed file size!" << endl;
+		return false;
+	}
+	
+	if (IsSectionInFile(header.triangleOffset,
+			(size_t)header.numberOfTriangles * sizeof(md2::Triangle), md2_file_size) == false) {
+		cerr << "ERROR: Triangles exceed file size!" << endl;
+		return false;
+	}
+	
+	if (IsSectionInFile(header.frameOffset,
+			(size_t)header.numberOfFrames * GetFrameSize(), md2_file_size) == false) {
+		cerr << "ERROR: Frames exceed file size!" << endl;
+		return false;
+	}
+	
+	if (IsSectionInFile(header.graphicCommandOffset,
+			(size_t)header.numberOfGraphicCommands * sizeof(int), md2_file_size) == false) {
+		cerr << "ERROR: GL commands exceed file size!" << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+bool MD2Model::IsSectionInFile(const int& offset, const size_t& size, const size_t& md2_file_size) {
+	
+	// offset + size <= md2_file_size, in size_t and without overflowing...
+	
+	if (offset < 0) return false;
+	if (md2_file_size < (size_t)offset) return false;
+	if (md2_file_size - (size_t)offset < size) return false;
+	
+	return true;
+}
+
+unsigned int MD2Model::GetFrameSize() {
+	
+	// Frame header (scale, translate, name) followed by the frame vertices...
+	
+	return
+		sizeof_member(md2::Frame, scale) +
+		sizeof_member(md2::Frame, translate) +
+		sizeof_member(md2::Frame, name) +
+		header.numberOfVertices * sizeof(md2::Vertex);
+}
+
+bool MD2Model::LoadModel(const string& md2_path) {
+	
+	fstream md2_file(md2_path.c_str(), fstream::in | fstream::binary);
+
+	if (md2_file.good() == false) {
+		cerr << "ERROR: MD2 file failed to load!" << endl;
+		engine.Stop();
+		return false;
+	}
+	
+	// Get file size in bytes...
+
+	size_t md2_file_size;
+
+	md2_file.seekg(0, md2_file.end);
+	md2_file_size = md2_file.tellg();
+
+	cout << "File Size " << md2_file_size << endl;
+
+	md2_file.seekg(0, md2_file.beg); // Reset file handle
+	md2_file.clear(); // Reset file flags
+
+	// Read header...
+
+	unsigned int md2_header_size = sizeof(md2::Header);
+
+	if (md2_file_size < md2_header_size) {
+		cerr << "ERROR: File is smaller than header size!" << endl;
 		md2_file.close();
 		engine.Stop();
-		return;
+		return false;
+	}
+
+	md2_file.read((char*)&header, md2_header_size);
+	
+	if (ValidateHeader(md2_file_size) == false) {
+		md2_file.close();
+		engine.Stop();
+		return false;
 	}
 	
 	// Read texture coordinates...
@@ -136,7 +212,7 @@ void MD2Model::LoadModel(const string& md2_path) {
 		cerr << "ERROR: Failed to allocate memory for texture coordinates!" << endl;
 		md2_file.close();
 		engine.Stop();
-		return;
+		return false;
 	}
 
 	md2_file.seekg(header.textureCoordinateOffset, md2_file.beg);
@@ -150,12 +226,26 @@ void MD2Model::LoadModel(const string& md2_path) {
 		cerr << "ERROR: Failed to allocate memory for triangles!" << endl;
 		md2_file.close();
 		engine.Stop();
-		return;
+		return false;
 	}
 
 	md2_file.seekg(header.triangleOffset, md2_file.beg);
 	md2_file.read((char*)triangles, header.numberOfTriangles * sizeof(md2::Triangle));
 
+	// Read GL commands...
+
+	graphic_commands = new int[header.numberOfGraphicCommands];
+
+	if (graphic_commands == NULL) {
+		cerr << "ERROR: Failed to allocate memory for GL commands!" << endl;
+		md2_file.close();
+		engine.Stop();
+		return false;
+	}
+
+	md2_file.seekg(header.graphicCommandOffset, md2_file.beg);
+	md2_file.read((char*)graphic_commands, (size_t)header.numberOfGraphicCommands * sizeof(int));
+
 	// Load frame data...
 
 	frames = new md2::Frame[header.numberOfFrames];
@@ -164,7 +254,7 @@ void MD2Model::LoadModel(const string& md2_path) {
 		cerr << "ERROR: Failed to allocate memory for frames!" << endl;
 		md2_file.close();
 		engine.Stop();
-		return;
+		return false;
 	}
 
 	md2_file.seekg(header.frameOffset, md2_file.beg);
@@ -191,33 +281,184 @@ void MD2Model::LoadModel(const string& md2_path) {
 			cerr << "ERROR: Failed to allocate memory for vertices!" << endl;
 			md2_file.close();
 			engine.Stop();
-			return;
+			return false;
 		}
 
 		md2_file.read((char*)frames[frame_index].vertices, header.numberOfVertices * sizeof(md2::Vertex));
 	}
 	
 	md2_file.close();
+	
+	return true;
+}
+
+bool MD2Model::MapModel(const string& md2_path) {
+	
+	/* Note:
+	 * The file is mapped read-only and the texture coordinates, triangles
+	 * and frame vertices point straight into the mapping (zero-copy).
+	 * Pages are shared between every process mapping the same file.
+	 * Returns false if the file cannot be mapped, so the caller can fall back to streaming.
+	 */
+	
+	int md2_file = open(md2_path.c_str(), O_RDONLY);
+	
+	if (md2_file < 0) {
+		cerr << "ERROR: MD2 file failed to open!" << endl;
+		return false;
+	}
+	
+	// Get file size in bytes...
+	
+	struct stat md2_file_status;
+	
+	if (fstat(md2_file, &md2_file_status) != 0) {
+		cerr << "ERROR: MD2 file failed to stat!" << endl;
+		close(md2_file);
+		return false;
+	}
+	
+	const size_t md2_file_size = md2_file_status.st_size;
+	
+	cout << "File Size " << md2_file_size << endl;
+	
+	if (md2_file_size < sizeof(md2::Header)) {
+		cerr << "ERROR: File is smaller than header size!" << endl;
+		close(md2_file);
+		return false;
+	}
+	
+	void* md2_mapping = mmap(NULL, md2_file_size, PROT_READ, MAP_PRIVATE, md2_file, 0);
+	
+	close(md2_file); // The mapping keeps its own reference to the file
+	
+	if (md2_mapping == MAP_FAILED) {
+		cerr << "ERROR: MD2 file failed to map!" << endl;
+		return false;
+	}
+	
+	// Copy header...
+	
+	memcpy(&header, md2_mapping, sizeof(md2::Header));
+	
+	if (ValidateHeader(md2_file_size) == false) {
+		munmap(md2_mapping, md2_file_size);
+		return false;
+	}
+	
+	// Sections must be aligned to be used in-place...
+	
+	if ((header.textureCoordinateOffset % sizeof(short)) != 0 ||
+		(header.triangleOffset % sizeof(short)) != 0 ||
+		(header.graphicCommandOffset % sizeof(int)) != 0 ||
+		(header.frameOffset % sizeof(float)) != 0 ||
+		(GetFrameSize() % sizeof(float)) != 0) {
+		
+		cerr << "ERROR: MD2 sections are not aligned for mapping!" << endl;
+		munmap(md2_mapping, md2_file_size);
+		return false;
+	}
+	
+	const char* md2_data = (const char*)md2_mapping;
+	
+	// Point texture coordinates and triangles into the mapping...
+	
+	texture_coordinates = (md2::TextureCoordinate*)(md2_data + header.textureCoordinateOffset);
+	triangles = (md2::Triangle*)(md2_data + header.triangleOffset);
+	graphic_commands = (int*)(md2_data + header.graphicCommandOffset);
+	
+	// Load frame data...
+	
+	/* Note:
+	 * md2::Frame holds a pointer to its vertices,
+	 * so the (small) frame headers are copied into one array
+	 * while the vertices are used in-place.
+	 */
+	
+	frames = new md2::Frame[header.numberOfFrames];
+	
+	const char* frame_data = md2_data + header.frameOffset;
+	
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+		
+		const char* frame_pointer = frame_data;
+		
+		memcpy(&(frames[frame_index].scale), frame_pointer, sizeof_member(md2::Frame, scale));
+		frame_pointer += sizeof_member(md2::Frame, scale);
+		
+		memcpy(&(frames[frame_index].translate), frame_pointer, sizeof_member(md2::Frame, translate));
+		frame_pointer += sizeof_member(md2::Frame, translate);
+		
+		memcpy(&(frames[frame_index].name), frame_pointer, sizeof_member(md2::Frame, name));
+		frame_pointer += sizeof_member(md2::Frame, name);
+		
+		frames[frame_index].name[sizeof_member(md2::Frame, name) - 1] = '\0';
+		
+		// Add an entry for the frame in the frame index...
+		
+		string frame_name = string(frames[frame_index].name);
+		
+		frame_lookup[frame_name] = frame_index;
+		
+		cout << "Frame Index " << frame_index << " Name " << frame_name << endl;
+		
+		// Point frame vertices into the mapping...
+		
+		frames[frame_index].vertices = (md2::Vertex*)frame_pointer;
+		
+		frame_data += GetFrameSize();
+	}
+	
+	mapping = md2_mapping;
+	mapping_size = md2_file_size;
+	
+	return true;
 }
 
 void MD2Model::UnloadModel() {
 	
+	if (mapping != NULL) {
+		
+		// Texture coordinates, triangles and vertices belong to the mapping...
+		
+		munmap(mapping, mapping_size);
+		
+		mapping = NULL;
+		mapping_size = 0;
+		
+		texture_coordinates = NULL;
+		triangles = NULL;
+		graphic_commands = NULL;
+		
+		if (frames != NULL) {
+			delete [] frames;
+			frames = NULL;
+		}
+		
+		return;
+	}
+	
 	if (texture_coordinates != NULL) {
-		delete texture_coordinates;
+		delete [] texture_coordinates;
 		texture_coordinates = NULL;
 	}
 
 	if (triangles != NULL) {
-		delete triangles;
+		delete [] triangles;
 		triangles = NULL;
 	}
 	
+	if (graphic_commands != NULL) {
+		delete [] graphic_commands;
+		graphic_commands = NULL;
+	}
+	
 	if (frames != NULL) {
 
 		for (unsigned int i = 0; i < header.numberOfFrames; i++) {
 
 			if (frames[i].vertices != NULL) {
-				delete frames[i].vertices;
+				delete [] frames[i].vertices;
 				frames[i].vertices = NULL;
 			}
 		}
@@ -227,13 +468,15 @@ void MD2Model::UnloadModel() {
 	}
 }
 
-void MD2Model::LoadTexture(const string& skin_path) {
+bool MD2Model::LoadTexture(const string& skin_path) {
+	
+	// Decode only, the image is uploaded by UploadTexture on the render thread...
 	
 	unsigned int skin_width;
 	unsigned int skin_height;
 	unsigned char skin_bytes_per_pixel;
 	
-	skin_texture = SystemInstance<Video>()->LoadTexture(
+	skin_image = Video::DecodeTexture(
 		skin_path,
 		skin_width,
 		skin_height,
@@ -241,55 +484,239 @@ void MD2Model::LoadTexture(const string& skin_path) {
 		TextureFilter_Toon
 	);
 	
-	if (skin_texture < 0) {
+	if (skin_image == NULL) {
 		cerr << "ERROR: Failed to load skin texture!" << endl;
 		engine.Stop();
-		return;
+		return false;
 	}
 
 	if (header.skinWidth != skin_width) {
 		cerr << "ERROR: Image width does not match header! " << skin_width << endl;
 		engine.Stop();
-		return;
+		return false;
 	}
 
 	if (header.skinHeight != skin_height) {
 		cerr << "ERROR: Image height does not match header! " << skin_height << endl;
 		engine.Stop();
-		return;
+		return false;
 	}
+	
+	return true;
+}
+
+bool MD2Model::UploadTexture() {
+	
+	if (skin_image == NULL) return false;
+	
+	skin_texture = SystemInstance<Video>()->UploadTexture(skin_image, GetTexturePath(), TextureFilter_Toon);
+	skin_image = NULL; // Released by UploadTexture
+	
+	if (skin_texture == 0) {
+		cerr << "ERROR: Failed to upload skin texture!" << endl;
+		engine.Stop();
+		return false;
+	}
+	
+	return true;
 }
 
 void MD2Model::UnloadTexture() {
 	
+	if (skin_image != NULL) {
+		Video::FreeTexture(skin_image);
+		skin_image = NULL;
+	}
+	
+	if (skin_texture == 0) return;
+	
 	SystemInstance<Video>()->UnloadTexture(skin_texture);
+	skin_texture = 0;
 }
 
-MD2Model::MD2Model(const AnimationInfo& animation_info) : AnimationModel(animation_info),
+MD2Model::MD2Model(
+	const AnimationInfo& animation_info,
+	const ModelLoadMode& load_mode,
+	const bool& defer_loading,
+	const KeyframeStorage& keyframe_storage) : AnimationModel(animation_info),
+		load_mode(load_mode),
+		skin_image(NULL),
+		skin_texture(0),
 		texture_coordinates(NULL),
 		triangles(NULL),
 		frames(NULL),
-		skin_texture(0) {
+		graphic_commands(NULL),
+		mapping(NULL),
+		mapping_size(0),
+		baked_data(NULL),
+		baked_size(0),
+		baked_mapped(false),
+		baked_texture_coordinates(NULL),
+		commands(NULL),
+		command_vertices(NULL),
+		number_of_commands(0),
+		mesh_vertices(NULL),
+		mesh_indices(NULL),
+		number_of_mesh_vertices(0),
+		number_of_mesh_indices(0),
+		keyframes(NULL),
+		vertex_stride(0),
+		pose_buffer(NULL),
+		bounding_radius(0.0f),
+		pose_cache_frame(0),
+		keyframe_storage((keyframe_storage == KEYFRAME_STORAGE_DEFAULT) ? default_keyframe_storage : keyframe_storage),
+		quantized_frames(NULL),
+		quantized_vertices(NULL),
+		decoded_buffer(NULL) {
 	
-	cout << "Loading MD2 Model..." << endl;
+	ResetResidency();
 	
-	cout << "MD2 path " << GetModelPath() << endl;
-	LoadModel(GetModelPath());
+	SetReady(false);
 	
-	cout << "Skin path " << GetTexturePath() << endl;
-	LoadTexture(GetTexturePath());
+	if (defer_loading) return;
+	
+	if (Load()) {
+		Upload();
+	}
 }
 
-MD2Model::MD2Model(const string& act_path) : AnimationModel(act_path) {
-	MD2Model(GetAnimationInfo());
+MD2Model::MD2Model(
+	const string& act_path,
+	const ModelLoadMode& load_mode,
+	const bool& defer_loading,
+	const KeyframeStorage& keyframe_storage) : AnimationModel(),
+		act_path(act_path),
+		load_mode(load_mode),
+		skin_image(NULL),
+		skin_texture(0),
+		texture_coordinates(NULL),
+		triangles(NULL),
+		frames(NULL),
+		graphic_commands(NULL),
+		mapping(NULL),
+		mapping_size(0),
+		baked_data(NULL),
+		baked_size(0),
+		baked_mapped(false),
+		baked_texture_coordinates(NULL),
+		commands(NULL),
+		command_vertices(NULL),
+		number_of_commands(0),
+		mesh_vertices(NULL),
+		mesh_indices(NULL),
+		number_of_mesh_vertices(0),
+		number_of_mesh_indices(0),
+		keyframes(NULL),
+		vertex_stride(0),
+		pose_buffer(NULL),
+		bounding_radius(0.0f),
+		pose_cache_frame(0),
+		keyframe_storage((keyframe_storage == KEYFRAME_STORAGE_DEFAULT) ? default_keyframe_storage : keyframe_storage),
+		quantized_frames(NULL),
+		quantized_vertices(NULL),
+		decoded_buffer(NULL) {
+	
+	ResetResidency();
+	
+	if (defer_loading) return;
+	
+	if (Load()) {
+		Upload();
+	}
 }
 
 MD2Model::~MD2Model() {
 	
+	UnloadBakedModel(); // Before UnloadModel: triangles may belong to the baked data
 	UnloadModel();
 	UnloadTexture();
 }
 
+bool MD2Model::Load() {
+	
+	// Load ACT file...
+	
+	if (act_path.empty() == false) {
+		
+		const AnimationInfo animation_info(act_path);
+		
+		if (animation_info.IsLoaded() == false) {
+			cerr << "ERROR: Failed to load ACT file " << act_path << "!" << endl;
+			return false;
+		}
+		
+		SetAnimationInfo(animation_info);
+	}
+	
+	cout << "Loading MD2 Model..." << endl;
+	
+	cout << "MD2 path " << GetModelPath() << endl;
+	
+	// Use the baked model if it is up to date...
+	
+	const string baked_path = GetModelPath() + MD2C_EXTENSION;
+	
+	if (LoadBakedModel(baked_path, GetModelPath(), load_mode) == false) {
+		
+		bool loaded = false;
+		
+		if (load_mode != MODEL_LOAD_STREAM) {
+			
+			loaded = MapModel(GetModelPath());
+			
+			if (loaded == false) {
+				
+				cerr << "ERROR: Failed to map MD2 model, streaming instead!" << endl;
+				
+				UnloadModel();
+				frame_lookup.clear();
+			}
+		}
+		
+		if (loaded == false) {
+			loaded = LoadModel(GetModelPath());
+		}
+		
+		// Decode once and keep the result for the next load...
+		
+		if (loaded == false || BakeModel(GetModelPath()) == false) {
+			cerr << "ERROR: Failed to bake MD2 model!" << endl;
+			engine.Stop();
+			return false;
+		}
+		
+		if (SaveBakedModel(baked_path) && (load_mode == MODEL_LOAD_LAZY || keyframe_storage == KEYFRAME_STORAGE_QUANTIZED)) {
+			
+			// Map the saved file, so keyframes can be paged in and out...
+			// Or read it again without the decoded keyframes, which a quantized model does not use...
+			
+			UnloadBakedModel();
+			frame_lookup.clear();
+			
+			if (LoadBakedModel(baked_path, GetModelPath(), load_mode) == false) {
+				cerr << "ERROR: Failed to load baked model!" << endl;
+				engine.Stop();
+				return false;
+			}
+		}
+	}
+	
+	cout << "Keyframe storage " << KeyframeStorageToString(keyframe_storage) << ", keyframe bytes " << GetKeyframeSize() << endl;
+	
+	cout << "Skin path " << GetTexturePath() << endl;
+	
+	return LoadTexture(GetTexturePath());
+}
+
+bool MD2Model::Upload() {
+	
+	if (UploadTexture() == false) return false;
+	
+	SetReady(true);
+	
+	return true;
+}
+
 int MD2Model::FindFrameIndex(string const& frame_name) {
 
 	/* // ##### Slow Alternative Method ##### //
@@ -312,332 +739,490 @@ int MD2Model::FindFrameIndex(string const& frame_name) {
 	return frame_index;
 }
 
-void MD2Model::Render(Animation* object) {
+const float* MD2Model::GetPose(
+	Video* gfx,
+	const int& current_frame_index,
+	const int& next_frame_index,
+	const float& frame_interp,
+	float& interp) {
 	
-	Video* gfx = SystemInstance<Video>();
+	/* Note:
+	 * Instances of a model in the same action often show the same frames at about the same time,
+	 * so interpolated poses are cached for the frame, keyed by both frames and the quantized frame_interp.
+	 * Quantizing moves frame_interp by at most half a step (see Video::GetPoseCacheSteps), fewer steps hit more often.
+	 * Poses live in the frame arena, so the cache is emptied every frame.
+	 */
 	
-	const glm::vec4 light_position = object->GetLightPosition();
-	const glm::vec4 view_positon = object->GetViewPosition();
+	md2c::Keyframe current_frame;
+	md2c::Keyframe next_frame;
 	
-	const unsigned int current_frame_index = object->GetCurrentFrameIndex();
-	const unsigned int next_frame_index = object->GetNextFrameIndex();
+	interp = gfx->IsInterpolationEnabled() ? frame_interp : 0.0f;
 	
-	const float frame_interp = object->GetFrameInterp();
+	const unsigned int steps = gfx->GetPoseCacheSteps();
 	
-	/* Note: frame_interpolation...
-	 * - Range of 0.0f and 1.0f
-	 * - Used to calculate an interpolated frame between the current frame and the next
-	 * - Increased over time
-	 */
+	unsigned int step = 0;
 	
-	//cout << "Frame info " << current_frame_index << " " << next_frame_index << endl;
+	if (steps > 0) {
+		step = (unsigned int)(interp * steps + 0.5f);
+		interp = (float)step / (float)steps;
+	}
 	
-	assert(current_frame_index < header.numberOfFrames);
-	assert(next_frame_index < header.numberOfFrames);
+	// Keyframes are poses already...
 	
-	// Rending buffers - Filled and then passed as arrays to OpenGL
+	if (interp == 0.0f || interp == 1.0f) {
+		
+		const int frame_index = (interp == 0.0f) ? current_frame_index : next_frame_index;
+		
+		GetKeyframes(frame_index, frame_index, current_frame, next_frame);
+		
+		return current_frame.positions[X];
+	}
 	
-	vector<float> texture_coordinate_buffer;
-	vector<float> colour_buffer;
-	vector<float> normal_buffer;
-	vector<float> vertex_buffer;
+	// ##### INTERPOLATE ##### //
 	
-	// Loop variables
+	/* Note:
+	 * The arrays of a keyframe are contiguous (x, y, z, nx, ny, nz), aligned and padded,
+	 * so the whole keyframe is interpolated at once by the SIMD kernel (see Interpolate).
+	 * Normals are resolved from md2::NORMALS, positions decompressed and axis swapped, when baked.
+	 */
 	
-	short k; // Temporary index
+	if (steps == 0) {
+		GetKeyframes(current_frame_index, next_frame_index, current_frame, next_frame);
+		Interpolate(current_frame.positions[X], next_frame.positions[X], interp, pose_buffer, 6 * vertex_stride);
+		return pose_buffer;
+	}
 	
-	glm::vec3 N, M; // Temporary normals
-	glm::vec3 u, v; // Temporary vectors
+	if (pose_cache_frame != gfx->GetFrameNumber()) {
+		pose_cache.clear();
+		pose_cache_frame = gfx->GetFrameNumber();
+	}
 	
-	glm::vec2 triangle_texture_coordinates[3];
+	for (unsigned int i = 0; i < pose_cache.size(); i++) {
+		
+		const PoseCacheEntry& entry = pose_cache[i];
+		
+		if (entry.current_frame_index == current_frame_index && entry.next_frame_index == next_frame_index && entry.step == step) {
+			gfx->CountPose(true);
+			return entry.pose;
+		}
+	}
 	
-	glm::vec3 triangle_normals[3];
-	glm::vec3 triangle_vertices[3];
-	glm::vec3 triangle_colours[3];
+	gfx->CountPose(false);
 	
-	md2::Frame current_frame    = frames[current_frame_index];
-	md2::Frame next_frame       = frames[next_frame_index];
+	GetKeyframes(current_frame_index, next_frame_index, current_frame, next_frame);
 	
-	// ...
+	// Not cached when full...
 	
-	if (gfx->IsDebuggingVectors()) {
-		glPushAttrib(GL_ALL_ATTRIB_BITS);
-	}
+	float* pose = pose_buffer;
 	
-	for (int i = 0; i < header.numberOfTriangles; i++) { // For each triangle...
-		for (unsigned char j = 0; j < 3; j++) { // For each triangle vertex...
-
-			// Select vertex...
-
-			k = triangles[i].vertexIndices[j];
-
-			if (header.numberOfVertices <= k || k < 0) {
-				cerr << "ERROR: Invalid vertex index! " << k << endl;
-				continue;
-			}
-
-			md2::Vertex current_vertex  = current_frame.vertices[k];
-			md2::Vertex next_vertex     = next_frame.vertices[k];
+	if (pose_cache.size() < MD2_POSE_CACHE_SIZE) {
+		
+		float* cached_pose = gfx->GetFrameArena()->Allocate<float>(6 * vertex_stride);
+		
+		if (cached_pose != NULL) {
 			
-			// ##### TEXTURE COORDINATES ##### //
+			PoseCacheEntry entry;
 			
-			/* Note:
-			 * 1. Scale to between 0.0 and 1.0 by dividing both the s and t components by skinWidth and skinHeight respectively
-			 * 2. (FALSE) The t coordinate is flipped so it must be converted via 1.0 - t
-			 */
+			entry.current_frame_index = current_frame_index;
+			entry.next_frame_index = next_frame_index;
+			entry.step = step;
+			entry.pose = cached_pose;
 			
-			k = triangles[i].textureCoordinateIndices[j];
-
-			if (header.numberOfTextureCoordinates <= k || k < 0) {
-				cerr << "ERROR: Invalid texture coordinate index! " << k << endl;
-				continue;
-			}
-
-			md2::TextureCoordinate texture_coordinate = texture_coordinates[k];
+			pose_cache.push_back(entry);
+			
+			pose = cached_pose;
+		}
+	}
+	
+	Interpolate(current_frame.positions[X], next_frame.positions[X], interp, pose, 6 * vertex_stride);
+	
+	return pose;
+}
 
-			float s = ((float)texture_coordinate.s / (float)header.skinWidth);
-			float t = ((float)texture_coordinate.t / (float)header.skinHeight);
+void MD2Model::ShadeVertices(
+	Video* gfx,
+	const MeshStream& stream,
+	const float* pose,
+	const int& current_frame_index,
+	const int& next_frame_index,
+	const float& interp,
+	const glm::vec4& light_position,
+	float* colour_buffer,
+	float* normal_buffer,
+	float* vertex_buffer) {
+	
+	/* Note:
+	 * The toggles are resolved before the loop, so the loop has no branches:
+	 * - Without cel shading, the light intensity is weighted by zero (white)
+	 * - The lighting table or the point light is chosen once, each with its own loop
+	 */
+	
+	const float shading = gfx->IsCelshadingEnabled() ? 1.0f : 0.0f;
+	
+	const glm::vec3 light(light_position[X], light_position[Y], light_position[Z]);
+	
+	const float* pose_positions[3] = {pose + 0 * vertex_stride, pose + 1 * vertex_stride, pose + 2 * vertex_stride};
+	const float* pose_normals[3]   = {pose + 3 * vertex_stride, pose + 4 * vertex_stride, pose + 5 * vertex_stride};
+	
+	// ##### SHADE ##### //
+	
+	const int number_of_vertices = stream.vertex_indices.size();
+	const int* vertex_indices = &stream.vertex_indices[0];
+	
+	float* colours = colour_buffer;
+	float* normals = normal_buffer;
+	float* vertices = vertex_buffer;
+	
+	for (int i = 0; i < number_of_vertices; i++) {
+		
+		const int k = vertex_indices[i];
+		
+		normals[3 * i + X] = pose_normals[X][k];
+		normals[3 * i + Y] = pose_normals[Y][k];
+		normals[3 * i + Z] = pose_normals[Z][k];
+		
+		vertices[3 * i + X] = pose_positions[X][k];
+		vertices[3 * i + Y] = pose_positions[Y][k];
+		vertices[3 * i + Z] = pose_positions[Z][k];
+	}
+	
+	// ##### COLOURS ##### //
+	
+	// Note: Cel shading is calculated using Quake 2 normals!
+	
+	if (gfx->IsLightingTableEnabled()) {
+		
+		/* Note:
+		 * Every keyframe normal is one of md2::NORMALS, so with the light as a direction
+		 * (from the model origin, in model space) each of them is lit once per instance and frame.
+		 * A vertex looks up the normal indices of both keyframes and lerps the intensities,
+		 * which equals lighting the lerped normal, since the intensity is linear in the normal.
+		 */
+		
+		float intensities[256]; // By normal index, zero for invalid indices (as when baked)
+		
+		memset(intensities, 0, sizeof(intensities));
+		
+		const glm::vec3 direction = (glm::length(light) > 0.0f) ? glm::normalize(light) : light;
+		
+		for (int n = 0; n < MD2_MAX_NORMALS; n++) {
+			intensities[n] = glm::dot(direction, glm::vec3(md2::NORMALS[n][X], md2::NORMALS[n][Y], md2::NORMALS[n][Z]));
+		}
+		
+		const md2::Vertex* current_vertices = quantized_vertices + current_frame_index * header.numberOfVertices;
+		const md2::Vertex* next_vertices = quantized_vertices + next_frame_index * header.numberOfVertices;
+		
+		for (int i = 0; i < number_of_vertices; i++) {
 			
-			triangle_texture_coordinates[j] = glm::vec2(s, t);
+			const int k = vertex_indices[i];
 			
-			// ##### INTERPOLATE NORMALS ##### //
+			const float current_intensity = intensities[current_vertices[k].normalIndex];
+			const float next_intensity = intensities[next_vertices[k].normalIndex];
 			
-			k = current_vertex.normalIndex;
+			const float intensity = current_intensity + interp * (next_intensity - current_intensity);
 			
-			if (MD2_MAX_NORMALS <= k || k < 0) {
-				cerr << "ERROR: Invalid normal index! " << k << endl;
-				continue;
-			}
-
-			N[X] = md2::NORMALS[k][X];
-			N[Y] = md2::NORMALS[k][Y];
-			N[Z] = md2::NORMALS[k][Z];
-
-			if (gfx->IsInterpolationEnabled()) {
-				
-				// Linear interpolation...
-				
-				/* Note:
-				 * Calculate a new vertex position using:
-				 * - current_frame
-				 * - next_frame
-				 * - frame_interp
-				 * Possible for higher orders of interpolation!
-				 * See Animation::GetFrameIndex
-				 */
-				
-				k = next_vertex.normalIndex;
-
-				if (MD2_MAX_NORMALS <= k || k < 0) {
-					cerr << "ERROR: Invalid normal index! " << k << endl;
-					continue;
-				}
-
-				// Lookup the next vertex normal...
-				M[X] = md2::NORMALS[k][X];
-				M[Y] = md2::NORMALS[k][Y];
-				M[Z] = md2::NORMALS[k][Z];
-
-				// Linearly interpolate over n and m...
-				N += frame_interp * (M - N);
-			}
-
-			triangle_normals[j] = N;
+			const float shadow = 1.0f + shading * (intensity - 1.0f);
 			
-			// ##### VERTICES ##### //
+			colours[3 * i + X] = shadow;
+			colours[3 * i + Y] = shadow;
+			colours[3 * i + Z] = shadow;
+		}
+	}
+	else {
+		
+		for (int i = 0; i < number_of_vertices; i++) {
 			
-			/* Note:
-			 * - Vertices in Quake 2 have the z and y axes are swapped
-			 * - MD2 models need components swapped for correct orientation
-			 */
+			const glm::vec3 N(normals[3 * i + X], normals[3 * i + Y], normals[3 * i + Z]);
+			const glm::vec3 u(vertices[3 * i + X], vertices[3 * i + Y], vertices[3 * i + Z]);
 			
-			// Decompress current vertex...
-			u[X] = (current_frame.scale[X] * current_vertex.components[X] + current_frame.translate[X]);
-			u[Y] = (current_frame.scale[Z] * current_vertex.components[Z] + current_frame.translate[Z]);
-			u[Z] = (current_frame.scale[Y] * current_vertex.components[Y] + current_frame.translate[Y]);
+			const float intensity = glm::dot(glm::normalize(light - u), N);
 			
-			if (gfx->IsInterpolationEnabled()) {
-				
-				// Linear Interpolation...
+			//glm::vec3 shadow = glm::log2(1.0f + intensity) * glm::vec3(1.0f, 1.0f, 1.0f);
+			
+			const float shadow = 1.0f + shading * (intensity - 1.0f);
+			
+			colours[3 * i + X] = shadow;
+			colours[3 * i + Y] = shadow;
+			colours[3 * i + Z] = shadow;
+		}
+	}
+	
+	gfx->CountVertices(number_of_vertices);
+}
 
-				// Decompress next vertex...
-				v[X] = (next_frame.scale[X] * next_vertex.components[X] + next_frame.translate[X]);
-				v[Y] = (next_frame.scale[Z] * next_vertex.components[Z] + next_frame.translate[Z]);
-				v[Z] = (next_frame.scale[Y] * next_vertex.components[Y] + next_frame.translate[Y]);
-				
-				// Linearly interpolate over u and v...
-				u += frame_interp * (v - u);
-			}
+void MD2Model::DrawDebugVectors(
+	Video* gfx,
+	const glm::mat4& orientation,
+	const glm::vec4& light_position,
+	const glm::vec4& view_positon,
+	const float* normal_buffer,
+	const float* vertex_buffer,
+	const unsigned int& number_of_vertices) {
+	
+	/* Note:
+	 * Segments are queued in world space and drawn by Video at the end of the frame, in one draw.
+	 * Only every Nth vertex is queued (see Video::GetDebugVectorStep), and queueing stops when Video is full.
+	 */
+	
+	#define ARROW_LENGTH (3.0f)
+	
+	const glm::vec3 black(0.0f, 0.0f, 0.0f);
+	const glm::vec3 white(1.0f, 1.0f, 1.0f);
+	const glm::vec3 violet(1.0f, 0.0f, 1.0f);
+	const glm::vec3 green(0.0f, 1.0f, 0.0f);
+	
+	const glm::mat4 R = glm::rotate(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+	
+	const unsigned int step = gfx->GetDebugVectorStep();
+	
+	for (unsigned int i = 0; i < number_of_vertices; i += step) {
+		
+		const glm::vec3 u(vertex_buffer[3 * i + X], vertex_buffer[3 * i + Y], vertex_buffer[3 * i + Z]);
+		const glm::vec3 N(normal_buffer[3 * i + X], normal_buffer[3 * i + Y], normal_buffer[3 * i + Z]);
+		
+		const glm::vec4 source = glm::vec4(u, 1.0f);
+		const glm::vec4 world_source = orientation * source;
+		
+		// ##### DEBUGGING ##### //
+		
+		if (gfx->IsDebuggingLighting()) {
 			
-			triangle_vertices[j] = u;
+			// Debug light direction...
+			// Draw a line gradient from the surface (black) to the light position (white)...
 			
-			// ##### COLOURS ##### //
+			const glm::vec4 L = glm::normalize(light_position - source); // Vector
 			
-			glm::vec4 L = glm::normalize(light_position - glm::vec4(u, 1.0f)); // Vector
-			glm::vec4 V = glm::normalize(view_positon - glm::vec4(u, 1.0f)); // Vector
+			const glm::vec4 destination = source + ARROW_LENGTH*L;
 			
-			triangle_colours[j] = glm::vec3(1.0f, 1.0f, 1.0f);
+			if (gfx->AddDebugLine(world_source, black, orientation * destination, white) == false) return;
+		}
+		
+		if (gfx->IsDebuggingView()) {
 			
-			if (gfx->IsCelshadingEnabled()) { // Phong lighting?
+			// Debug view direction...
+			// Draw a line gradient from the surface (black)
+			// perpendicular (so it is visible) to the camera position (violet)...
 			
-				// Note: Cel shading is calculated using Quake 2 normals!
-				float intensity = glm::dot(L, glm::vec4(N, 0.0f));
-				
-				//glm::vec3 shadow = glm::log2(1.0f + intensity) * glm::vec3(1.0f, 1.0f, 1.0f);
-				
-				glm::vec3 shadow = intensity * glm::vec3(1.0f, 1.0f, 1.0f);
-				
-				triangle_colours[j] = shadow;
-			}
+			const glm::vec4 V = glm::normalize(view_positon - source); // Vector
 			
-			// ##### DEBUGGING ##### //
+			const glm::vec4 destination = source + ARROW_LENGTH*R*V;
 			
-			#define ARROW_LENGTH (3.0f)
+			if (gfx->AddDebugLine(world_source, black, orientation * destination, violet) == false) return;
+		}
+		
+		if (gfx->IsDebuggingNormals()) {
 			
-			if (gfx->IsDebuggingLighting()) {
-				
-				// Debug light direction...
-				// Draw a line gradient from the surface (black) to the light position (white)...
-				
-				const glm::vec4 source = glm::vec4(u, 1.0f);
-				const glm::vec4 destination = source + ARROW_LENGTH*L;
-				
-				glDisable(GL_LIGHTING);
-				glEnable(GL_LINE_SMOOTH);
-				glLineWidth(3.0f);
-
-				glBegin(GL_LINES);
-
-				glColor3f(0.0f, 0.0f, 0.0f); // Black at source
-				glVertex3fv(glm::value_ptr(source));
-
-				glColor3f(1.0f, 1.0f, 1.0f); // White at destination
-				glVertex3fv(glm::value_ptr(destination));
-
-				glEnd();
-			}
+			// Debug normals...
+			// Draw a line gradient from the surface (black) along the surface normal (green)...
 			
-			if (gfx->IsDebuggingView()) {
-				
-				// Debug view direction...
-				// Draw a line gradient from the surface (black)
-				// perpendicular (so it is visible) to the camera position (violet)...
-				
-				const glm::mat4 R = glm::rotate(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-				
-				const glm::vec4 source = glm::vec4(u, 1.0f);
-				const glm::vec4 destination = source + ARROW_LENGTH*R*V;
-				
-				glDisable(GL_LIGHTING);
-				glEnable(GL_LINE_SMOOTH);
-				glLineWidth(3.0f); 
-
-				glBegin(GL_LINES);
-
-				glColor3f(0.0f, 0.0f, 0.0f); // Black at source
-				glVertex3fv(glm::value_ptr(source));
-
-				glColor3f(1.0f, 0.0f, 1.0f); // Violet at destination
-				glVertex3fv(glm::value_ptr(destination));
-
-				glEnd();
-			}
+			const glm::vec4 destination = glm::vec4(u + ARROW_LENGTH*N, 1.0f);
 			
-			if (gfx->IsDebuggingNormals()) {
-				
-				// Debug normals...
-				// Draw a line gradient from the surface (black) along the surface normal (green)...
-				
-				const glm::vec3 source = u;
-				const glm::vec3 destination = source + ARROW_LENGTH*N;
-				
-				glDisable(GL_LIGHTING);
-				glEnable(GL_LINE_SMOOTH);
-				glLineWidth(3.0f); 
-
-				glBegin(GL_LINES);
-
-				glColor3f(0.0f, 0.0f, 0.0f); // Black at source
-				glVertex3fv(glm::value_ptr(source));
-
-				glColor3f(0.0f, 1.0f, 0.0f); // Green at destination
-				glVertex3fv(glm::value_ptr(destination));
-
-				glEnd();
-			}
+			if (gfx->AddDebugLine(world_source, black, orientation * destination, green) == false) return;
 		}
-		
-		// ##### Subdivision ##### //
-		
-		int subdivide_depth = gfx->IsSubdivisionEnabled() ? 2 : 0;
-		
-		Subdivide2D( // Subdivide texture coordinates
-			subdivide_depth,
-			texture_coordinate_buffer,
-			triangle_texture_coordinates[0],
-			triangle_texture_coordinates[1],
-			triangle_texture_coordinates[2]
-		);
-		
-		Subdivide3D( // Subdivide colour coordinates
-			subdivide_depth,
-			colour_buffer,
-			triangle_colours[0],
-			triangle_colours[1],
-			triangle_colours[2]
-		);
-		
-		Subdivide3D( // Subdivide normals
-			subdivide_depth,
-			normal_buffer,
-			triangle_normals[0],
-			triangle_normals[1],
-			triangle_normals[2]
-		);
-		
-		Subdivide3D( // Subdivide vertices
-			subdivide_depth,
-			vertex_buffer,
-			triangle_vertices[0],
-			triangle_vertices[1],
-			triangle_vertices[2]
-		);
 	}
+}
+
+void MD2Model::Render(Animation* object) {
+	
+	PROFILE_ZONE("MD2Model::Render");
+	
+	Video* gfx = SystemInstance<Video>();
+	
+	const glm::vec4 light_position = object->GetLightPosition();
+	const glm::vec4 view_positon = object->GetViewPosition();
+	
+	const unsigned int current_frame_index = object->GetCurrentFrameIndex();
+	const unsigned int next_frame_index = object->GetNextFrameIndex();
+	
+	const float frame_interp = object->GetFrameInterp();
+	
+	/* Note: frame_interpolation...
+	 * - Range of 0.0f and 1.0f
+	 * - Used to calculate an interpolated frame between the current frame and the next
+	 * - Increased over time
+	 */
+	
+	//cout << "Frame info " << current_frame_index << " " << next_frame_index << endl;
+	
+	assert(current_frame_index < header.numberOfFrames);
+	assert(next_frame_index < header.numberOfFrames);
+	
+	if (baked_data == NULL) return; // Model failed to load
+	
+	if (IsResidencyManaged() && MD2_RESIDENCY_INTERVAL <= SDL_GetTicks() - last_eviction) {
+		EvictActions();
+		last_eviction = SDL_GetTicks();
+	}
+	
+	// Select mesh path, falling back if the model has no strips or mesh...
+	
+	MeshPath mesh_path = gfx->GetMeshPath();
+	
+	if (mesh_path == MESH_INDEXED && number_of_mesh_indices == 0) mesh_path = MESH_STRIPS;
+	if (mesh_path == MESH_STRIPS && number_of_commands == 0) mesh_path = MESH_TRIANGLES;
+	
+	const MeshStream& stream = streams[mesh_path];
+	
+	if (stream.vertex_indices.empty()) return;
+	
+	// Rending buffers - Filled and then passed as arrays to OpenGL
+	// Allocated from the frame arena, so they are exactly sized and released by Video at the end of the frame
+	
+	Arena* arena = gfx->GetFrameArena();
+	
+	const unsigned int number_of_vertices = stream.vertex_indices.size();
+	
+	float* colour_buffer = arena->Allocate<float>(3 * number_of_vertices);
+	float* normal_buffer = arena->Allocate<float>(3 * number_of_vertices);
+	float* vertex_buffer = arena->Allocate<float>(3 * number_of_vertices);
+	
+	if (colour_buffer == NULL || normal_buffer == NULL || vertex_buffer == NULL) return;
+	
+	// Quantized keyframes are decoded here (see KEYFRAME_STORAGE_QUANTIZED), unless the pose is cached...
+	
+	float interp;
+	
+	const float* pose = GetPose(gfx, current_frame_index, next_frame_index, frame_interp, interp);
+	
+	/* Note:
+	 * Each vertex of the stream is lit once:
+	 * - Indexed: each welded vertex (see MD2Model::BakeMesh)
+	 * - Strips: each strip and fan vertex
+	 * - Triangles: each triangle corner
+	 */
+	
+	ShadeVertices(
+		gfx,
+		stream,
+		pose,
+		current_frame_index,
+		next_frame_index,
+		interp,
+		light_position,
+		colour_buffer,
+		normal_buffer,
+		vertex_buffer);
 	
 	if (gfx->IsDebuggingVectors()) {
-		glPopAttrib();
+		DrawDebugVectors(gfx, object->GetOrientation(), light_position, view_positon, normal_buffer, vertex_buffer, number_of_vertices);
 	}
 	
-	// ##### RENDERING ##### //
-	// Faster drawing using buffered arrays
+	// ##### Subdivision ##### //
+	
+	/* Note:
+	 * Subdivision blends the shaded vertices by the triangles of the stream:
+	 * - Indexed: each new vertex once, drawn through the index buffer of the topology (see Subdivision::BuildTopology)
+	 * - Expanded: every triangle writes its own vertices, drawn as independent triangles
+	 * Indexed shares edges between the triangles of the stream, so it shares the most with MESH_INDEXED (welded vertices).
+	 */
+	
+	// Less detail when smaller on screen, see Video::SelectSubdivisionDepth...
 	
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	const float projected_size = gfx->GetProjectedSize(object->GetPosition(), bounding_radius);
 	
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, skin_texture);
+	const unsigned int subdivide_depth = gfx->SelectSubdivisionDepth(projected_size, object->GetSubdivisionDepth());
 	
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
+	object->SetSubdivisionDepth(subdivide_depth);
 	
-	glTexCoordPointer(2, GL_FLOAT, 0, &texture_coordinate_buffer[0]);
-	glColorPointer(3, GL_FLOAT, 0, &colour_buffer[0]);
-	glNormalPointer(GL_FLOAT, 0, &normal_buffer[0]); // Use Quake 2 normals
-	//glNormalPointer(GL_FLOAT, 0, &vertex_buffer[0]);
-	glVertexPointer(3, GL_FLOAT, 0, &vertex_buffer[0]);
+	const bool subdivide = gfx->IsSubdivisionEnabled() && subdivide_depth > 0;
+	const bool subdivide_indexed = subdivide && gfx->IsIndexedSubdivisionEnabled();
 	
-	glDrawArrays(GL_TRIANGLES, 0, vertex_buffer.size() / 3);
+	const unsigned int number_of_triangles = stream.triangle_indices.size() / 3;
 	
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_COLOR_ARRAY);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	const SubdivisionTopology* topology = subdivide_indexed ? &GetSubdivisionTopology(mesh_path, subdivide_depth) : NULL;
 	
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glEnable(GL_TEXTURE_2D);
+	unsigned int number_of_subdivided_vertices = 0;
 	
-	glPopAttrib();
+	if (subdivide_indexed) number_of_subdivided_vertices = topology->vertices.size();
+	else if (subdivide) number_of_subdivided_vertices = number_of_triangles * SubdividedVertexCount(subdivide_depth);
+	
+	SubdivisionOutput subdivided;
+	
+	if (subdivide) {
+		
+		subdivided.texture_coordinates = subdivide_indexed ? NULL : arena->Allocate<float>(2 * number_of_subdivided_vertices); // Static when indexed
+		subdivided.colours = arena->Allocate<float>(3 * number_of_subdivided_vertices);
+		subdivided.normals = arena->Allocate<float>(3 * number_of_subdivided_vertices);
+		subdivided.vertices = arena->Allocate<float>(3 * number_of_subdivided_vertices);
+		
+		if ((subdivide_indexed == false && subdivided.texture_coordinates == NULL) || subdivided.colours == NULL || subdivided.normals == NULL || subdivided.vertices == NULL) return;
+		
+		SubdivisionInput corners;
+		
+		corners.triangle_indices = &stream.triangle_indices[0];
+		corners.texture_coordinates = &stream.texture_coordinates[0];
+		corners.colours = colour_buffer;
+		corners.normals = normal_buffer;
+		corners.vertices = vertex_buffer;
+		
+		if (subdivide_indexed) {
+			SystemInstance<Subdivision>()->SubdivideIndexed(*topology, corners, subdivided);
+		}
+		else {
+			SystemInstance<Subdivision>()->Subdivide(subdivide_depth, corners, number_of_triangles, subdivided);
+		}
+		
+		gfx->CountVertices(number_of_subdivided_vertices);
+	}
+	
+	// ##### RENDERING ##### //
+	// Faster drawing using buffered arrays
+	
+	// State is left as set for the next model, so models sharing a skin change nothing (see StateCache)...
+	
+	StateCache* state = gfx->GetStateCache();
+	
+	state->Enable(GL_TEXTURE_2D);
+	state->BindTexture(skin_texture);
+	
+	state->EnableClientState(GL_TEXTURE_COORD_ARRAY);
+	state->EnableClientState(GL_COLOR_ARRAY);
+	state->EnableClientState(GL_NORMAL_ARRAY);
+	state->EnableClientState(GL_VERTEX_ARRAY);
+	
+	if (subdivide_indexed) {
+		
+		glTexCoordPointer(2, GL_FLOAT, 0, &topology->texture_coordinates[0]); // Static
+		glColorPointer(3, GL_FLOAT, 0, subdivided.colours);
+		glNormalPointer(GL_FLOAT, 0, subdivided.normals); // Use Quake 2 normals
+		glVertexPointer(3, GL_FLOAT, 0, subdivided.vertices);
+		
+		glDrawElements(GL_TRIANGLES, topology->triangle_indices.size(), GL_UNSIGNED_INT, &topology->triangle_indices[0]);
+	}
+	else if (subdivide) {
+		
+		glTexCoordPointer(2, GL_FLOAT, 0, subdivided.texture_coordinates);
+		glColorPointer(3, GL_FLOAT, 0, subdivided.colours);
+		glNormalPointer(GL_FLOAT, 0, subdivided.normals); // Use Quake 2 normals
+		glVertexPointer(3, GL_FLOAT, 0, subdivided.vertices);
+		
+		glDrawArrays(GL_TRIANGLES, 0, number_of_subdivided_vertices);
+	}
+	else {
+		
+		glTexCoordPointer(2, GL_FLOAT, 0, &stream.texture_coordinates[0]); // Static
+		glColorPointer(3, GL_FLOAT, 0, colour_buffer);
+		glNormalPointer(GL_FLOAT, 0, normal_buffer); // Use Quake 2 normals
+		//glNormalPointer(GL_FLOAT, 0, vertex_buffer);
+		glVertexPointer(3, GL_FLOAT, 0, vertex_buffer);
+		
+		switch (mesh_path) {
+			
+			case MESH_INDEXED: {
+				glDrawElements(GL_TRIANGLES, stream.triangle_indices.size(), GL_UNSIGNED_SHORT, &stream.triangle_indices[0]);
+			} break;
+			
+			case MESH_STRIPS: {
+				for (int i = 0; i < number_of_commands; i++) {
+					glDrawArrays(commands[i].fan ? GL_TRIANGLE_FAN : GL_TRIANGLE_STRIP, commands[i].first, commands[i].count);
+				}
+			} break;
+			
+			default: {
+				glDrawArrays(GL_TRIANGLES, 0, number_of_vertices);
+			} break;
+		}
+	}
 }
 
 const float md2::NORMALS[MD2_MAX_NORMALS][3] = {
@@ -0,0 +1,1650 @@
+#include "MD2.hpp"
+#include "Process.hpp"
+#include "Misc.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h> // SDL_GetTicks
+
+using namespace std;
+
+/* Note:
+ * The baked model (.md2c) stores what MD2Model::Render used to compute every frame:
+ * - Positions are decompressed with the frame scale/translate and axis swapped
+ * - Normals are resolved from the md2::NORMALS lookup table
+ * - Texture coordinates are divided by the skin dimensions
+ * The file is an image of the in-memory layout,
+ * so loading it is a single read (or a single mapping) with no decoding.
+ * The quantized frames are kept as well, for models which trade decoding for memory (see KeyframeStorage).
+ */
+
+static unsigned int AlignOffset(const unsigned int& offset) {
+	return (offset + MD2C_ALIGNMENT - 1) & ~(MD2C_ALIGNMENT - 1);
+}
+
+static unsigned int AlignVertexCount(const unsigned int& count) {
+	return (count + MD2C_VERTEX_ALIGNMENT - 1) & ~(MD2C_VERTEX_ALIGNMENT - 1);
+}
+
+bool MD2Model::BakeCommands(vector<md2c::Command>& baked_commands, vector<md2::CommandVertex>& baked_command_vertices) {
+
+	/* Note:
+	 * The GL commands are a variable length list, so they are parsed once here.
+	 * Commands which leave the list or use invalid vertices are dropped,
+	 * then the model falls back to rendering triangles if none are left.
+	 */
+
+	if (graphic_commands == NULL) return false;
+
+	int invalid_commands = 0;
+	int i = 0;
+
+	while (i < header.numberOfGraphicCommands) {
+
+		const int n = graphic_commands[i++];
+
+		if (n == 0) break; // End of list
+
+		if (n == INT_MIN) {
+			invalid_commands++;
+			break; // Cannot be negated
+		}
+
+		const int count = (n < 0) ? -n : n;
+
+		if (count > (header.numberOfGraphicCommands - i) / 3) {
+			invalid_commands++;
+			break; // Leaves the list
+		}
+
+		const md2::CommandVertex* source_vertices = (const md2::CommandVertex*)(graphic_commands + i);
+
+		i += count * 3;
+
+		bool valid = (3 <= count);
+
+		for (int j = 0; j < count && valid; j++) {
+			const int vertex_index = source_vertices[j].vertexIndex;
+			valid = (0 <= vertex_index && vertex_index < header.numberOfVertices);
+		}
+
+		if (valid == false) {
+			invalid_commands++;
+			continue;
+		}
+
+		md2c::Command command;
+
+		command.fan = (n < 0) ? 1 : 0;
+		command.first = baked_command_vertices.size();
+		command.count = count;
+
+		baked_commands.push_back(command);
+		baked_command_vertices.insert(baked_command_vertices.end(), source_vertices, source_vertices + count);
+	}
+
+	if (invalid_commands > 0) {
+		cerr << "ERROR: Invalid GL commands! " << invalid_commands << endl;
+	}
+
+	cout << "Number of Strips and Fans " << baked_commands.size() << endl;
+	cout << "Number of Strip and Fan Vertices " << baked_command_vertices.size() << endl;
+
+	return (baked_commands.empty() == false);
+}
+
+/* Note:
+ * Triangle order for the post-transform vertex cache (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+ * Triangles are picked greedily by the score of their vertices:
+ * - Vertices recently used (in the cache) score higher
+ * - Vertices with few triangles left score higher, so they can leave the cache sooner
+ */
+
+static float VertexCacheScore(const int& cache_position, const int& remaining_triangles) {
+
+	if (remaining_triangles == 0) return -1.0f; // No triangles left to draw
+
+	float score = 0.0f;
+
+	if (cache_position >= 0) {
+
+		if (cache_position < 3) {
+			score = 0.75f; // Used by the last triangle, fixed so no order is favoured
+		}
+		else {
+			const float scale = 1.0f / (float)(MD2C_VERTEX_CACHE_SIZE - 3);
+			score = powf(1.0f - (float)(cache_position - 3) * scale, 1.5f);
+		}
+	}
+
+	score += 2.0f / sqrtf((float)remaining_triangles);
+
+	return score;
+}
+
+static void OptimizeVertexCache(vector<unsigned short>& indices, const int& number_of_vertices) {
+
+	const int number_of_triangles = indices.size() / 3;
+
+	// Triangles using each vertex: active triangles are kept at the front of each vertex range...
+
+	vector<int> triangle_offsets(number_of_vertices + 1, 0);
+
+	for (unsigned int i = 0; i < indices.size(); i++) {
+		triangle_offsets[indices[i] + 1]++;
+	}
+
+	for (int v = 0; v < number_of_vertices; v++) {
+		triangle_offsets[v + 1] += triangle_offsets[v];
+	}
+
+	vector<int> vertex_triangles(indices.size());
+	vector<int> remaining_triangles(number_of_vertices, 0);
+
+	for (unsigned int i = 0; i < indices.size(); i++) {
+		const int v = indices[i];
+		vertex_triangles[triangle_offsets[v] + remaining_triangles[v]++] = i / 3;
+	}
+
+	vector<int> cache_positions(number_of_vertices, -1);
+	vector<float> vertex_scores(number_of_vertices);
+
+	for (int v = 0; v < number_of_vertices; v++) {
+		vertex_scores[v] = VertexCacheScore(-1, remaining_triangles[v]);
+	}
+
+	vector<float> triangle_scores(number_of_triangles);
+	vector<bool> emitted(number_of_triangles, false);
+
+	for (int t = 0; t < number_of_triangles; t++) {
+		triangle_scores[t] =
+			vertex_scores[indices[3 * t + 0]] +
+			vertex_scores[indices[3 * t + 1]] +
+			vertex_scores[indices[3 * t + 2]];
+	}
+
+	vector<unsigned short> ordered;
+	ordered.reserve(indices.size());
+
+	vector<int> cache; // Most recently used first
+	vector<int> next_cache;
+
+	int best_triangle = -1;
+
+	while ((int)ordered.size() < number_of_triangles * 3) {
+
+		if (best_triangle < 0) {
+
+			// Nothing in the cache is left, start from the best triangle anywhere...
+
+			for (int t = 0; t < number_of_triangles; t++) {
+				if (emitted[t]) continue;
+				if (best_triangle < 0 || triangle_scores[best_triangle] < triangle_scores[t]) {
+					best_triangle = t;
+				}
+			}
+		}
+
+		const int t = best_triangle;
+
+		emitted[t] = true;
+
+		// Emit the triangle and update the cache...
+
+		next_cache.clear();
+
+		for (unsigned char j = 0; j < 3; j++) {
+
+			const int v = indices[3 * t + j];
+
+			ordered.push_back(v);
+			next_cache.push_back(v);
+
+			// Remove the triangle from the active triangles of the vertex...
+
+			int* active = &vertex_triangles[triangle_offsets[v]];
+
+			for (int k = 0; k < remaining_triangles[v]; k++) {
+				if (active[k] == t) {
+					active[k] = active[remaining_triangles[v] - 1];
+					break;
+				}
+			}
+
+			remaining_triangles[v]--;
+		}
+
+		for (unsigned int i = 0; i < cache.size(); i++) {
+			if (cache[i] != next_cache[0] && cache[i] != next_cache[1] && cache[i] != next_cache[2]) {
+				next_cache.push_back(cache[i]);
+			}
+		}
+
+		// Rescore the vertices in (or just evicted from) the cache and their triangles...
+
+		best_triangle = -1;
+
+		for (unsigned int i = 0; i < next_cache.size(); i++) {
+
+			const int v = next_cache[i];
+
+			cache_positions[v] = (i < MD2C_VERTEX_CACHE_SIZE) ? i : -1;
+			vertex_scores[v] = VertexCacheScore(cache_positions[v], remaining_triangles[v]);
+		}
+
+		for (unsigned int i = 0; i < next_cache.size(); i++) {
+
+			const int v = next_cache[i];
+
+			for (int k = 0; k < remaining_triangles[v]; k++) {
+
+				const int u = vertex_triangles[triangle_offsets[v] + k];
+
+				triangle_scores[u] =
+					vertex_scores[indices[3 * u + 0]] +
+					vertex_scores[indices[3 * u + 1]] +
+					vertex_scores[indices[3 * u + 2]];
+
+				if (best_triangle < 0 || triangle_scores[best_triangle] < triangle_scores[u]) {
+					best_triangle = u;
+				}
+			}
+		}
+
+		if (MD2C_VERTEX_CACHE_SIZE < next_cache.size()) {
+			next_cache.resize(MD2C_VERTEX_CACHE_SIZE);
+		}
+
+		cache.swap(next_cache);
+	}
+
+	indices.swap(ordered);
+}
+
+// Average number of vertices shaded per triangle with a FIFO cache, 0.5 to 3.0 (lower is better)
+static float AverageCacheMissRatio(const vector<unsigned short>& indices, const int& number_of_vertices) {
+
+	if (indices.empty()) return 0.0f;
+
+	vector<unsigned int> cache_times(number_of_vertices, 0); // Time each vertex entered the cache, 0 if never
+	unsigned int misses = 0;
+
+	for (unsigned int i = 0; i < indices.size(); i++) {
+
+		const int v = indices[i];
+
+		if (cache_times[v] == 0 || MD2C_VERTEX_CACHE_SIZE < misses + 1 - cache_times[v]) {
+			misses++;
+			cache_times[v] = misses;
+		}
+	}
+
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+bool MD2Model::BakeMesh(const vector<md2::Triangle>& valid_triangles, vector<md2c::MeshVertex>& baked_vertices, vector<unsigned short>& baked_indices) {
+
+	/* Note:
+	 * Most corners of neighbouring triangles share both their vertex and texture coordinate,
+	 * so each unique pair is welded into one mesh vertex and the triangles are indexed.
+	 * Render then interpolates and lights each mesh vertex once.
+	 */
+
+	const float skin_width = (header.skinWidth > 0) ? (float)header.skinWidth : 1.0f;
+	const float skin_height = (header.skinHeight > 0) ? (float)header.skinHeight : 1.0f;
+
+	map<pair<short, short>, unsigned short> welded_vertices;
+
+	vector<md2c::MeshVertex> vertices;
+	vector<unsigned short> indices;
+
+	for (unsigned int i = 0; i < valid_triangles.size(); i++) {
+		for (unsigned char j = 0; j < 3; j++) {
+
+			const pair<short, short> key(valid_triangles[i].vertexIndices[j], valid_triangles[i].textureCoordinateIndices[j]);
+
+			map<pair<short, short>, unsigned short>::iterator results = welded_vertices.find(key);
+
+			if (results != welded_vertices.end()) {
+				indices.push_back(results->second);
+				continue;
+			}
+
+			md2c::MeshVertex vertex;
+
+			vertex.s = (float)texture_coordinates[key.second].s / skin_width;
+			vertex.t = (float)texture_coordinates[key.second].t / skin_height;
+			vertex.vertexIndex = key.first;
+
+			welded_vertices[key] = vertices.size();
+
+			indices.push_back(vertices.size());
+			vertices.push_back(vertex);
+		}
+	}
+
+	// Reorder triangles for the vertex cache...
+
+	const float original_ratio = AverageCacheMissRatio(indices, vertices.size());
+
+	OptimizeVertexCache(indices, vertices.size());
+
+	cout << "Vertex cache miss ratio " << original_ratio << " to " << AverageCacheMissRatio(indices, vertices.size()) << endl;
+
+	// Reorder vertices by first use, so they are fetched in order...
+
+	vector<int> remap(vertices.size(), -1);
+
+	baked_vertices.clear();
+	baked_indices.resize(indices.size());
+
+	for (unsigned int i = 0; i < indices.size(); i++) {
+
+		if (remap[indices[i]] < 0) {
+			remap[indices[i]] = baked_vertices.size();
+			baked_vertices.push_back(vertices[indices[i]]);
+		}
+
+		baked_indices[i] = remap[indices[i]];
+	}
+
+	cout << "Number of Mesh Vertices " << baked_vertices.size() << endl;
+	cout << "Number of Mesh Indices " << baked_indices.size() << endl;
+
+	return (baked_indices.empty() == false);
+}
+
+bool MD2Model::BakeModel(const string& md2_path) {
+
+	cout << "Baking MD2 Model..." << endl;
+
+	assert(frames != NULL);
+	assert(triangles != NULL);
+	assert(texture_coordinates != NULL);
+
+	// Sanitize the triangles once, so Render never checks an index...
+
+	vector<md2::Triangle> valid_triangles;
+
+	for (int i = 0; i < header.numberOfTriangles; i++) {
+
+		bool valid = true;
+
+		for (unsigned char j = 0; j < 3 && valid; j++) {
+
+			const short vertex_index = triangles[i].vertexIndices[j];
+			const short texture_coordinate_index = triangles[i].textureCoordinateIndices[j];
+
+			valid = (0 <= vertex_index && vertex_index < header.numberOfVertices);
+			valid = valid && (0 <= texture_coordinate_index && texture_coordinate_index < header.numberOfTextureCoordinates);
+		}
+
+		if (valid) {
+			valid_triangles.push_back(triangles[i]);
+		}
+	}
+
+	if ((int)valid_triangles.size() < header.numberOfTriangles) {
+		cerr << "ERROR: Invalid triangles dropped! " << (header.numberOfTriangles - valid_triangles.size()) << endl;
+	}
+
+	vector<md2c::Command> baked_commands;
+	vector<md2::CommandVertex> baked_command_vertices;
+
+	BakeCommands(baked_commands, baked_command_vertices);
+
+	vector<md2c::MeshVertex> baked_mesh_vertices;
+	vector<unsigned short> baked_mesh_indices;
+
+	BakeMesh(valid_triangles, baked_mesh_vertices, baked_mesh_indices);
+
+	// Layout...
+
+	const unsigned int vertex_stride = AlignVertexCount(header.numberOfVertices);
+	const unsigned int keyframe_size = 6 * vertex_stride * sizeof(float);
+
+	md2c::Header baked_header;
+
+	memset(&baked_header, 0, sizeof(md2c::Header));
+	memcpy(baked_header.identity, MD2C_IDENTITY, sizeof_member(md2c::Header, identity));
+
+	baked_header.version = MD2C_VERSION;
+	baked_header.source = header;
+	baked_header.source.numberOfTriangles = valid_triangles.size();
+	baked_header.vertexStride = vertex_stride;
+
+	struct stat md2_file_status;
+
+	if (stat(md2_path.c_str(), &md2_file_status) == 0) {
+		baked_header.sourceSize = md2_file_status.st_size;
+		baked_header.sourceModified = md2_file_status.st_mtime;
+	}
+
+	unsigned int offset = AlignOffset(sizeof(md2c::Header));
+
+	baked_header.frameOffset = offset;
+	offset = AlignOffset(offset + header.numberOfFrames * sizeof_member(md2::Frame, name));
+
+	baked_header.triangleOffset = offset;
+	offset = AlignOffset(offset + baked_header.source.numberOfTriangles * sizeof(md2::Triangle));
+
+	baked_header.textureCoordinateOffset = offset;
+	offset = AlignOffset(offset + header.numberOfTextureCoordinates * sizeof(md2c::TextureCoordinate));
+
+	baked_header.numberOfCommands = baked_commands.size();
+	baked_header.numberOfCommandVertices = baked_command_vertices.size();
+
+	baked_header.commandOffset = offset;
+	offset = AlignOffset(offset + baked_header.numberOfCommands * sizeof(md2c::Command));
+
+	baked_header.commandVertexOffset = offset;
+	offset = AlignOffset(offset + baked_header.numberOfCommandVertices * sizeof(md2::CommandVertex));
+
+	baked_header.numberOfMeshVertices = baked_mesh_vertices.size();
+	baked_header.numberOfMeshIndices = baked_mesh_indices.size();
+
+	baked_header.meshVertexOffset = offset;
+	offset = AlignOffset(offset + baked_header.numberOfMeshVertices * sizeof(md2c::MeshVertex));
+
+	baked_header.meshIndexOffset = offset;
+	offset = AlignOffset(offset + baked_header.numberOfMeshIndices * sizeof(unsigned short));
+
+	baked_header.quantizedFrameOffset = offset;
+	offset = AlignOffset(offset + header.numberOfFrames * sizeof(md2c::QuantizedFrame));
+
+	baked_header.quantizedVertexOffset = offset;
+	offset = AlignOffset(offset + header.numberOfFrames * header.numberOfVertices * sizeof(md2::Vertex));
+
+	baked_header.keyframeOffset = offset;
+	offset = offset + header.numberOfFrames * keyframe_size;
+
+	baked_header.endOfFileOffset = offset;
+
+	// Allocate one aligned block for the whole model...
+
+	void* data = NULL;
+
+	if (posix_memalign(&data, MD2C_ALIGNMENT, baked_header.endOfFileOffset) != 0) {
+		cerr << "ERROR: Failed to allocate memory for baked model!" << endl;
+		return false;
+	}
+
+	char* baked = (char*)data;
+
+	memset(baked, 0, baked_header.endOfFileOffset); // Padding is zero
+	memcpy(baked, &baked_header, sizeof(md2c::Header));
+
+	// Frame names...
+
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+		char* name = baked + baked_header.frameOffset + frame_index * sizeof_member(md2::Frame, name);
+
+		memcpy(name, frames[frame_index].name, sizeof_member(md2::Frame, name));
+		name[sizeof_member(md2::Frame, name) - 1] = '\0';
+	}
+
+	// Triangles...
+
+	if (valid_triangles.empty() == false) {
+		memcpy(baked + baked_header.triangleOffset, &valid_triangles[0], valid_triangles.size() * sizeof(md2::Triangle));
+	}
+
+	// Texture coordinates...
+
+	/* Note:
+	 * Scale to between 0.0 and 1.0 by dividing both the s and t components by skinWidth and skinHeight respectively
+	 */
+
+	md2c::TextureCoordinate* baked_coordinates = (md2c::TextureCoordinate*)(baked + baked_header.textureCoordinateOffset);
+
+	const float skin_width = (header.skinWidth > 0) ? (float)header.skinWidth : 1.0f;
+	const float skin_height = (header.skinHeight > 0) ? (float)header.skinHeight : 1.0f;
+
+	for (int i = 0; i < header.numberOfTextureCoordinates; i++) {
+		baked_coordinates[i].s = (float)texture_coordinates[i].s / skin_width;
+		baked_coordinates[i].t = (float)texture_coordinates[i].t / skin_height;
+	}
+
+	// Strips and fans...
+
+	if (baked_commands.empty() == false) {
+		memcpy(baked + baked_header.commandOffset, &baked_commands[0], baked_commands.size() * sizeof(md2c::Command));
+		memcpy(baked + baked_header.commandVertexOffset, &baked_command_vertices[0], baked_command_vertices.size() * sizeof(md2::CommandVertex));
+	}
+
+	// Welded mesh...
+
+	if (baked_mesh_indices.empty() == false) {
+		memcpy(baked + baked_header.meshVertexOffset, &baked_mesh_vertices[0], baked_mesh_vertices.size() * sizeof(md2c::MeshVertex));
+		memcpy(baked + baked_header.meshIndexOffset, &baked_mesh_indices[0], baked_mesh_indices.size() * sizeof(unsigned short));
+	}
+
+	// Quantized frames...
+
+	md2c::QuantizedFrame* baked_quantized_frames = (md2c::QuantizedFrame*)(baked + baked_header.quantizedFrameOffset);
+	md2::Vertex* baked_quantized_vertices = (md2::Vertex*)(baked + baked_header.quantizedVertexOffset);
+
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+		const md2::Frame& frame = frames[frame_index];
+
+		md2c::QuantizedFrame& quantized_frame = baked_quantized_frames[frame_index];
+
+		quantized_frame.scale[X] = frame.scale[X];
+		quantized_frame.scale[Y] = frame.scale[Z];
+		quantized_frame.scale[Z] = frame.scale[Y];
+
+		quantized_frame.translate[X] = frame.translate[X];
+		quantized_frame.translate[Y] = frame.translate[Z];
+		quantized_frame.translate[Z] = frame.translate[Y];
+
+		memcpy(baked_quantized_vertices + frame_index * header.numberOfVertices, frame.vertices, header.numberOfVertices * sizeof(md2::Vertex));
+	}
+
+	// Keyframes...
+
+	int invalid_normals = 0;
+
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+		const md2::Frame& frame = frames[frame_index];
+
+		float* keyframe = (float*)(baked + baked_header.keyframeOffset + frame_index * keyframe_size);
+
+		float* x = keyframe + 0 * vertex_stride;
+		float* y = keyframe + 1 * vertex_stride;
+		float* z = keyframe + 2 * vertex_stride;
+
+		float* nx = keyframe + 3 * vertex_stride;
+		float* ny = keyframe + 4 * vertex_stride;
+		float* nz = keyframe + 5 * vertex_stride;
+
+		for (int k = 0; k < header.numberOfVertices; k++) {
+
+			const md2::Vertex& vertex = frame.vertices[k];
+
+			/* Note:
+			 * - Vertices in Quake 2 have the z and y axes are swapped
+			 * - MD2 models need components swapped for correct orientation
+			 */
+
+			x[k] = (frame.scale[X] * vertex.components[X] + frame.translate[X]);
+			y[k] = (frame.scale[Z] * vertex.components[Z] + frame.translate[Z]);
+			z[k] = (frame.scale[Y] * vertex.components[Y] + frame.translate[Y]);
+
+			if (MD2_MAX_NORMALS <= vertex.normalIndex) {
+				invalid_normals++;
+				continue; // Zero normal
+			}
+
+			nx[k] = md2::NORMALS[vertex.normalIndex][X];
+			ny[k] = md2::NORMALS[vertex.normalIndex][Y];
+			nz[k] = md2::NORMALS[vertex.normalIndex][Z];
+		}
+	}
+
+	if (invalid_normals > 0) {
+		cerr << "ERROR: Invalid normal indices! " << invalid_normals << endl;
+	}
+
+	// Replace the source model with the baked model...
+
+	UnloadModel();
+	frame_lookup.clear();
+
+	if (AttachBakedModel(baked, baked_header.endOfFileOffset, false) == false) {
+		free(baked);
+		return false;
+	}
+
+	return true;
+}
+
+bool MD2Model::AttachBakedModel(char* data, const size_t& size, const bool& mapped) {
+
+	// Validate header...
+
+	if (size < sizeof(md2c::Header)) {
+		cerr << "ERROR: Baked file is smaller than header size!" << endl;
+		return false;
+	}
+
+	const md2c::Header* baked_header = (const md2c::Header*)data;
+
+	if (strncmp(baked_header->identity, MD2C_IDENTITY, sizeof_member(md2c::Header, identity)) != 0) {
+		cerr << "ERROR: Invalid baked header identity!" << endl;
+		return false;
+	}
+
+	if (baked_header->version != MD2C_VERSION) {
+		cerr << "ERROR: Invalid baked header version!" << endl;
+		return false;
+	}
+
+	const md2::Header& source = baked_header->source;
+
+	if (source.numberOfVertices < 0 || MD2_MAX_VERTICES < source.numberOfVertices ||
+		source.numberOfTextureCoordinates < 0 || MD2_MAX_TEXTURE_COORDINATES < source.numberOfTextureCoordinates ||
+		source.numberOfTriangles < 0 || MD2_MAX_TRIANGLES < source.numberOfTriangles ||
+		source.numberOfFrames < 0 || MD2_MAX_FRAMES < source.numberOfFrames) {
+
+		cerr << "ERROR: Invalid baked model dimensions!" << endl;
+		return false;
+	}
+
+	if (baked_header->vertexStride != (int)AlignVertexCount(source.numberOfVertices)) {
+		cerr << "ERROR: Invalid baked vertex stride!" << endl;
+		return false;
+	}
+
+	if (baked_header->numberOfCommands < 0 || baked_header->numberOfCommandVertices < 0 ||
+		MD2_MAX_TRIANGLES < baked_header->numberOfCommands || 3 * MD2_MAX_TRIANGLES < baked_header->numberOfCommandVertices) {
+
+		cerr << "ERROR: Invalid baked command dimensions!" << endl;
+		return false;
+	}
+
+	if (baked_header->numberOfMeshVertices < 0 || baked_header->numberOfMeshIndices < 0 ||
+		3 * MD2_MAX_TRIANGLES < baked_header->numberOfMeshVertices || 3 * MD2_MAX_TRIANGLES < baked_header->numberOfMeshIndices ||
+		(baked_header->numberOfMeshIndices % 3) != 0) {
+
+		cerr << "ERROR: Invalid baked mesh dimensions!" << endl;
+		return false;
+	}
+
+	const unsigned int keyframe_size = 6 * baked_header->vertexStride * sizeof(float);
+
+	/* Note:
+	 * A quantized model may be given the file without its decoded keyframes (see LoadBakedModel),
+	 * so only the keyframes it uses must be in the data.
+	 */
+
+	const bool quantized = (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED);
+
+	const size_t keyframes_size = quantized ? 0 : (size_t)source.numberOfFrames * keyframe_size;
+
+	if (((size_t)baked_header->endOfFileOffset != size && (quantized == false || (size_t)baked_header->keyframeOffset != size)) ||
+		IsSectionInFile(baked_header->frameOffset, source.numberOfFrames * sizeof_member(md2::Frame, name), size) == false ||
+		IsSectionInFile(baked_header->triangleOffset, source.numberOfTriangles * sizeof(md2::Triangle), size) == false ||
+		IsSectionInFile(baked_header->textureCoordinateOffset, source.numberOfTextureCoordinates * sizeof(md2c::TextureCoordinate), size) == false ||
+		IsSectionInFile(baked_header->commandOffset, baked_header->numberOfCommands * sizeof(md2c::Command), size) == false ||
+		IsSectionInFile(baked_header->commandVertexOffset, baked_header->numberOfCommandVertices * sizeof(md2::CommandVertex), size) == false ||
+		IsSectionInFile(baked_header->meshVertexOffset, baked_header->numberOfMeshVertices * sizeof(md2c::MeshVertex), size) == false ||
+		IsSectionInFile(baked_header->meshIndexOffset, baked_header->numberOfMeshIndices * sizeof(unsigned short), size) == false ||
+		IsSectionInFile(baked_header->quantizedFrameOffset, source.numberOfFrames * sizeof(md2c::QuantizedFrame), size) == false ||
+		IsSectionInFile(baked_header->quantizedVertexOffset, (size_t)source.numberOfFrames * source.numberOfVertices * sizeof(md2::Vertex), size) == false ||
+		IsSectionInFile(baked_header->keyframeOffset, keyframes_size, size) == false) {
+
+		cerr << "ERROR: Baked sections exceed file size!" << endl;
+		return false;
+	}
+
+	if ((baked_header->keyframeOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->textureCoordinateOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->triangleOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->commandOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->commandVertexOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->meshVertexOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->meshIndexOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->quantizedFrameOffset % MD2C_ALIGNMENT) != 0 ||
+		(baked_header->quantizedVertexOffset % MD2C_ALIGNMENT) != 0 ||
+		((size_t)data % MD2C_ALIGNMENT) != 0) {
+
+		cerr << "ERROR: Baked sections are not aligned!" << endl;
+		return false;
+	}
+
+	// Triangles were sanitized when baked (see MD2Model::BakeModel)...
+
+	const md2::Triangle* baked_triangles = (const md2::Triangle*)(data + baked_header->triangleOffset);
+
+	for (int i = 0; i < source.numberOfTriangles; i++) {
+		for (unsigned char j = 0; j < 3; j++) {
+
+			const short vertex_index = baked_triangles[i].vertexIndices[j];
+			const short texture_coordinate_index = baked_triangles[i].textureCoordinateIndices[j];
+
+			if (vertex_index < 0 || source.numberOfVertices <= vertex_index ||
+				texture_coordinate_index < 0 || source.numberOfTextureCoordinates <= texture_coordinate_index) {
+
+				cerr << "ERROR: Invalid baked triangle!" << endl;
+				return false;
+			}
+		}
+	}
+
+	// Commands must stay within the command vertices and use valid vertices...
+
+	const md2c::Command* baked_commands = (const md2c::Command*)(data + baked_header->commandOffset);
+	const md2::CommandVertex* baked_command_vertices = (const md2::CommandVertex*)(data + baked_header->commandVertexOffset);
+
+	for (int i = 0; i < baked_header->numberOfCommands; i++) {
+
+		const md2c::Command& command = baked_commands[i];
+
+		if (command.first < 0 || command.count < 3 || baked_header->numberOfCommandVertices - command.first < command.count) {
+			cerr << "ERROR: Invalid baked command!" << endl;
+			return false;
+		}
+	}
+
+	for (int i = 0; i < baked_header->numberOfCommandVertices; i++) {
+		if (baked_command_vertices[i].vertexIndex < 0 || source.numberOfVertices <= baked_command_vertices[i].vertexIndex) {
+			cerr << "ERROR: Invalid baked command vertex!" << endl;
+			return false;
+		}
+	}
+
+	// Mesh indices and vertices must be in range...
+
+	const md2c::MeshVertex* baked_mesh_vertices = (const md2c::MeshVertex*)(data + baked_header->meshVertexOffset);
+	const unsigned short* baked_mesh_indices = (const unsigned short*)(data + baked_header->meshIndexOffset);
+
+	for (int i = 0; i < baked_header->numberOfMeshIndices; i++) {
+		if (baked_header->numberOfMeshVertices <= baked_mesh_indices[i]) {
+			cerr << "ERROR: Invalid baked mesh index!" << endl;
+			return false;
+		}
+	}
+
+	for (int i = 0; i < baked_header->numberOfMeshVertices; i++) {
+		if (baked_mesh_vertices[i].vertexIndex < 0 || source.numberOfVertices <= baked_mesh_vertices[i].vertexIndex) {
+			cerr << "ERROR: Invalid baked mesh vertex!" << endl;
+			return false;
+		}
+	}
+
+	// Interpolated keyframe, see MD2Model::ShadeVertices...
+
+	if (posix_memalign((void**)&pose_buffer, MD2C_ALIGNMENT, 6 * baked_header->vertexStride * sizeof(float)) != 0) {
+		cerr << "ERROR: Failed to allocate memory for pose!" << endl;
+		pose_buffer = NULL;
+		return false;
+	}
+
+	// Current and next keyframe of a quantized model, see MD2Model::GetKeyframes...
+
+	if (quantized) {
+
+		if (posix_memalign((void**)&decoded_buffer, MD2C_ALIGNMENT, 2 * keyframe_size) != 0) {
+			cerr << "ERROR: Failed to allocate memory for decoded keyframes!" << endl;
+			decoded_buffer = NULL;
+			free(pose_buffer);
+			pose_buffer = NULL;
+			return false;
+		}
+
+		memset(decoded_buffer, 0, 2 * keyframe_size); // Padding is zero
+
+		for (int slot = 0; slot < 2; slot++) {
+
+			const float* keyframe = decoded_buffer + slot * 6 * baked_header->vertexStride;
+
+			decoded_keyframes[slot].positions[X] = keyframe + 0 * baked_header->vertexStride;
+			decoded_keyframes[slot].positions[Y] = keyframe + 1 * baked_header->vertexStride;
+			decoded_keyframes[slot].positions[Z] = keyframe + 2 * baked_header->vertexStride;
+
+			decoded_keyframes[slot].normals[X] = keyframe + 3 * baked_header->vertexStride;
+			decoded_keyframes[slot].normals[Y] = keyframe + 4 * baked_header->vertexStride;
+			decoded_keyframes[slot].normals[Z] = keyframe + 5 * baked_header->vertexStride;
+
+			decoded_frame_indices[slot] = -1;
+		}
+	}
+
+	// Point into the baked data...
+
+	header = source;
+	vertex_stride = baked_header->vertexStride;
+
+	triangles = (md2::Triangle*)baked_triangles;
+	baked_texture_coordinates = (md2c::TextureCoordinate*)(data + baked_header->textureCoordinateOffset);
+
+	commands = (md2c::Command*)baked_commands;
+	command_vertices = (md2::CommandVertex*)baked_command_vertices;
+	number_of_commands = baked_header->numberOfCommands;
+
+	mesh_vertices = (md2c::MeshVertex*)baked_mesh_vertices;
+	mesh_indices = (unsigned short*)baked_mesh_indices;
+	number_of_mesh_vertices = baked_header->numberOfMeshVertices;
+	number_of_mesh_indices = baked_header->numberOfMeshIndices;
+
+	quantized_vertices = (md2::Vertex*)(data + baked_header->quantizedVertexOffset);
+
+	if (quantized) {
+		quantized_frames = (md2c::QuantizedFrame*)(data + baked_header->quantizedFrameOffset);
+	}
+	else {
+
+		keyframes = new md2c::Keyframe[header.numberOfFrames];
+
+		for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+			const float* keyframe = (const float*)(data + baked_header->keyframeOffset + frame_index * keyframe_size);
+
+			keyframes[frame_index].positions[X] = keyframe + 0 * baked_header->vertexStride;
+			keyframes[frame_index].positions[Y] = keyframe + 1 * baked_header->vertexStride;
+			keyframes[frame_index].positions[Z] = keyframe + 2 * baked_header->vertexStride;
+
+			keyframes[frame_index].normals[X] = keyframe + 3 * baked_header->vertexStride;
+			keyframes[frame_index].normals[Y] = keyframe + 4 * baked_header->vertexStride;
+			keyframes[frame_index].normals[Z] = keyframe + 5 * baked_header->vertexStride;
+		}
+	}
+
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+		// Add an entry for the frame in the frame index...
+
+		const char* name = data + baked_header->frameOffset + frame_index * sizeof_member(md2::Frame, name);
+
+		frame_lookup[string(name, strnlen(name, sizeof_member(md2::Frame, name)))] = frame_index;
+	}
+
+	// Bounds of every frame, from the quantized frames (always part of the baked data)...
+
+	const md2c::QuantizedFrame* bounds = (md2c::QuantizedFrame*)(data + baked_header->quantizedFrameOffset);
+
+	bounding_radius = 0.0f;
+
+	for (int frame_index = 0; frame_index < header.numberOfFrames; frame_index++) {
+
+		float extent = 0.0f;
+
+		for (unsigned char i = 0; i < 3; i++) {
+
+			// Components range from 0 to 255...
+
+			const float low = fabs(bounds[frame_index].translate[i]);
+			const float high = fabs(bounds[frame_index].translate[i] + 255.0f * bounds[frame_index].scale[i]);
+
+			extent += (low < high) ? high * high : low * low;
+		}
+
+		if (bounding_radius * bounding_radius < extent) bounding_radius = sqrtf(extent);
+	}
+
+	baked_data = data;
+	baked_size = size;
+	baked_mapped = mapped;
+
+	BuildStreams();
+	ResetResidency();
+
+	if (IsResidencyManaged()) {
+
+		// Keyframes are paged in per action, so disable read-ahead of neighbouring actions...
+
+		AdviseKeyframes(0, header.numberOfFrames, MADV_RANDOM);
+	}
+
+	return true;
+}
+
+bool MD2Model::LoadBakedModel(const string& md2c_path, const string& md2_path, const ModelLoadMode& load_mode) {
+
+	cout << "Baked path " << md2c_path << endl;
+
+	int md2c_file = open(md2c_path.c_str(), O_RDONLY);
+
+	if (md2c_file < 0) {
+		cout << "Baked file not found" << endl;
+		return false;
+	}
+
+	// Get file size in bytes...
+
+	struct stat md2c_file_status;
+
+	if (fstat(md2c_file, &md2c_file_status) != 0 || md2c_file_status.st_size < (off_t)sizeof(md2c::Header)) {
+		cerr << "ERROR: Baked file is smaller than header size!" << endl;
+		close(md2c_file);
+		return false;
+	}
+
+	const size_t md2c_file_size = md2c_file_status.st_size;
+
+	cout << "File Size " << md2c_file_size << endl;
+
+	// Single read (or a single mapping) of the whole file...
+
+	char* data = NULL;
+
+	if (load_mode != MODEL_LOAD_STREAM) {
+
+		void* md2c_mapping = mmap(NULL, md2c_file_size, PROT_READ, MAP_PRIVATE, md2c_file, 0);
+
+		if (md2c_mapping != MAP_FAILED) {
+			data = (char*)md2c_mapping;
+		}
+	}
+
+	const bool mapped = (data != NULL);
+
+	size_t data_size = md2c_file_size;
+
+	if (mapped == false) {
+
+		// A quantized model reads the file up to the decoded keyframes, which are last...
+
+		if (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED) {
+
+			md2c::Header file_header;
+
+			if (pread(md2c_file, &file_header, sizeof(md2c::Header), 0) == (ssize_t)sizeof(md2c::Header) &&
+				sizeof(md2c::Header) <= (size_t)file_header.keyframeOffset && (size_t)file_header.keyframeOffset <= md2c_file_size) {
+
+				data_size = file_header.keyframeOffset;
+			}
+		}
+
+		void* buffer = NULL;
+
+		if (posix_memalign(&buffer, MD2C_ALIGNMENT, data_size) != 0) {
+			cerr << "ERROR: Failed to allocate memory for baked model!" << endl;
+			close(md2c_file);
+			return false;
+		}
+
+		data = (char*)buffer;
+
+		size_t bytes_read = 0;
+
+		while (bytes_read < data_size) {
+
+			ssize_t result = read(md2c_file, data + bytes_read, data_size - bytes_read);
+
+			if (result <= 0) break;
+			bytes_read += result;
+		}
+
+		if (bytes_read != data_size) {
+			cerr << "ERROR: Failed to read baked file!" << endl;
+			free(data);
+			close(md2c_file);
+			return false;
+		}
+	}
+
+	close(md2c_file);
+
+	// Check that the baked file was made from the current MD2 file...
+
+	const md2c::Header* baked_header = (const md2c::Header*)data;
+
+	struct stat md2_file_status;
+
+	bool stale = false;
+
+	if (stat(md2_path.c_str(), &md2_file_status) == 0) {
+		stale = (baked_header->sourceSize != (long long)md2_file_status.st_size);
+		stale = stale || (baked_header->sourceModified != (long long)md2_file_status.st_mtime);
+	}
+
+	if (stale || AttachBakedModel(data, data_size, mapped) == false) {
+
+		cout << "Baked file is stale or invalid" << endl;
+
+		if (mapped) {
+			munmap(data, data_size);
+		}
+		else {
+			free(data);
+		}
+
+		frame_lookup.clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool MD2Model::SaveBakedModel(const string& md2c_path) {
+
+	assert(baked_data != NULL);
+
+	// Write to a temporary file and rename, so readers never see a partial file...
+	// Unique per call: loader workers may bake the same model at once (eg. two ACT files loaded outside the Registry)
+
+	static SDL_atomic_t next_temporary_file;
+
+	stringstream temporary_path;
+	temporary_path << md2c_path << "." << getpid() << "." << SDL_AtomicAdd(&next_temporary_file, 1) << ".tmp";
+
+	fstream md2c_file(temporary_path.str().c_str(), fstream::out | fstream::binary | fstream::trunc);
+
+	if (md2c_file.good() == false) {
+		cerr << "ERROR: Baked file failed to open for writing!" << endl;
+		return false;
+	}
+
+	md2c_file.write(baked_data, baked_size);
+	md2c_file.close();
+
+	if (md2c_file.fail() || rename(temporary_path.str().c_str(), md2c_path.c_str()) != 0) {
+		cerr << "ERROR: Baked file failed to write!" << endl;
+		remove(temporary_path.str().c_str());
+		return false;
+	}
+
+	cout << "Saved baked model " << md2c_path << endl;
+
+	return true;
+}
+
+void MD2Model::UnloadBakedModel() {
+
+	if (baked_data == NULL) return;
+
+	// Triangles, texture coordinates, commands and the mesh belong to the baked data...
+
+	triangles = NULL;
+	baked_texture_coordinates = NULL;
+
+	commands = NULL;
+	command_vertices = NULL;
+	number_of_commands = 0;
+
+	mesh_vertices = NULL;
+	mesh_indices = NULL;
+	number_of_mesh_vertices = 0;
+	number_of_mesh_indices = 0;
+
+	for (int i = 0; i < MESH_PATH_MAX; i++) {
+		streams[i] = MeshStream();
+	}
+
+	if (keyframes != NULL) {
+		delete [] keyframes;
+		keyframes = NULL;
+	}
+
+	quantized_frames = NULL;
+	quantized_vertices = NULL;
+
+	free(decoded_buffer);
+	decoded_buffer = NULL;
+
+	free(pose_buffer);
+	pose_buffer = NULL;
+	vertex_stride = 0;
+
+	if (baked_mapped) {
+		munmap(baked_data, baked_size);
+	}
+	else {
+		free(baked_data);
+	}
+
+	baked_data = NULL;
+	baked_size = 0;
+	baked_mapped = false;
+}
+
+// ##### Static streams...
+
+const SubdivisionTopology& MD2Model::GetSubdivisionTopology(const MeshPath& mesh_path, const unsigned int& depth) {
+	
+	MeshStream& stream = streams[mesh_path];
+	
+	SubdivisionTopology& topology = stream.subdivision_topologies[(depth < SUBDIVISION_MAX_DEPTH) ? depth : SUBDIVISION_MAX_DEPTH];
+	
+	// Static per stream and depth: built by BuildStreams for MESH_INDEXED, otherwise the first time it is drawn (after switching mesh path)...
+	
+	if (topology.vertices.empty() && stream.triangle_indices.empty() == false) {
+		
+		SystemInstance<Subdivision>()->BuildTopology(
+			depth,
+			&stream.triangle_indices[0],
+			stream.triangle_indices.size() / 3,
+			&stream.texture_coordinates[0],
+			topology);
+	}
+	
+	return topology;
+}
+
+void MD2Model::BuildStreams() {
+
+	/* Note:
+	 * Everything Render needs that does not change between frames, resolved once per mesh path:
+	 * - The vertex index of each vertex to shade, in draw order
+	 * - Texture coordinates of those vertices, passed to OpenGL as they are
+	 * - Triangles as indices into the shaded vertices, used for subdivision
+	 * The baked data was validated when attached, so Render does no checks.
+	 */
+
+	for (int i = 0; i < MESH_PATH_MAX; i++) {
+		streams[i] = MeshStream();
+	}
+
+	// Indexed...
+
+	MeshStream& indexed = streams[MESH_INDEXED];
+
+	for (int i = 0; i < number_of_mesh_vertices; i++) {
+		indexed.vertex_indices.push_back(mesh_vertices[i].vertexIndex);
+		indexed.texture_coordinates.push_back(mesh_vertices[i].s);
+		indexed.texture_coordinates.push_back(mesh_vertices[i].t);
+	}
+
+	indexed.triangle_indices.assign(mesh_indices, mesh_indices + number_of_mesh_indices);
+
+	// Strips and fans...
+
+	MeshStream& strips = streams[MESH_STRIPS];
+
+	for (int i = 0; i < number_of_commands; i++) {
+
+		const md2c::Command& command = commands[i];
+
+		for (int j = 0; j < command.count; j++) {
+
+			const md2::CommandVertex& command_vertex = command_vertices[command.first + j];
+
+			strips.vertex_indices.push_back(command_vertex.vertexIndex);
+			strips.texture_coordinates.push_back(command_vertex.s);
+			strips.texture_coordinates.push_back(command_vertex.t);
+
+			if (j < 2) continue;
+
+			// Split into triangles, keeping the winding of the strip...
+
+			if (command.fan) {
+				strips.triangle_indices.push_back(command.first);
+				strips.triangle_indices.push_back(command.first + j - 1);
+			}
+			else if (j % 2 == 0) {
+				strips.triangle_indices.push_back(command.first + j - 2);
+				strips.triangle_indices.push_back(command.first + j - 1);
+			}
+			else {
+				strips.triangle_indices.push_back(command.first + j - 1);
+				strips.triangle_indices.push_back(command.first + j - 2);
+			}
+
+			strips.triangle_indices.push_back(command.first + j);
+		}
+	}
+
+	// Triangles...
+
+	MeshStream& soup = streams[MESH_TRIANGLES];
+
+	for (int i = 0; i < header.numberOfTriangles; i++) {
+		for (unsigned char j = 0; j < 3; j++) {
+
+			const md2c::TextureCoordinate& texture_coordinate = baked_texture_coordinates[triangles[i].textureCoordinateIndices[j]];
+
+			soup.vertex_indices.push_back(triangles[i].vertexIndices[j]);
+			soup.texture_coordinates.push_back(texture_coordinate.s);
+			soup.texture_coordinates.push_back(texture_coordinate.t);
+			soup.triangle_indices.push_back(3 * i + j);
+		}
+	}
+
+	// Subdivision topologies of the mesh path Video starts with, at every depth (adaptive subdivision may pick any),
+	// built here by the loader rather than by the render thread the first time the model is drawn...
+
+	for (unsigned int depth = 1; depth <= SUBDIVISION_MAX_DEPTH; depth++) {
+		GetSubdivisionTopology(MESH_INDEXED, depth);
+	}
+}
+
+// ##### Keyframe residency...
+
+/* Note:
+ * With MODEL_LOAD_LAZY only the keyframes of actions in use are kept in memory.
+ * - An action is prefetched when an animation starts playing it (AcquireAction),
+ *   along with the action that most often followed it so far (or IDLE)
+ * - Keyframes of an action released (or prefetched unused) for MD2_RESIDENCY_TIMEOUT are evicted,
+ *   unless they share a page with keyframes still in use
+ * The baked file is mapped read-only, so evicted pages are read back from the file on demand.
+ */
+
+bool MD2Model::IsResidencyManaged() {
+	return (load_mode == MODEL_LOAD_LAZY) && baked_mapped;
+}
+
+void MD2Model::ResetResidency() {
+
+	resident_frames.assign((baked_data != NULL) ? header.numberOfFrames : 0, false);
+
+	for (int a = 0; a < ACTION_MAX; a++) {
+
+		action_users[a] = 0;
+		action_released[a] = 0;
+
+		for (int b = 0; b < ACTION_MAX; b++) {
+			action_transitions[a][b] = 0;
+		}
+	}
+
+	last_eviction = SDL_GetTicks();
+}
+
+bool MD2Model::GetActionFrames(const ActionType& action, int& first_frame, int& number_of_frames) {
+
+	if (action <= INVALID || ACTION_MAX <= action) return false;
+
+	const ActionInfo action_info = GetActionInfo(action);
+
+	first_frame = action_info.frameIndexOffset;
+	number_of_frames = action_info.numberOfFrames;
+
+	if (first_frame < 0 || number_of_frames <= 0) return false;
+	if (header.numberOfFrames < first_frame + number_of_frames) return false;
+
+	return true;
+}
+
+void MD2Model::AdviseKeyframes(const int& first_frame, const int& number_of_frames, const int& advice) {
+
+	if (baked_mapped == false || number_of_frames <= 0) return;
+
+	size_t keyframe_offset;
+	size_t keyframe_size;
+
+	GetKeyframeSection(keyframe_offset, keyframe_size);
+
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	size_t begin = keyframe_offset + first_frame * keyframe_size;
+	size_t end = begin + number_of_frames * keyframe_size;
+
+	if (advice == MADV_DONTNEED) {
+
+		// Only whole pages inside the range, neighbouring keyframes may be in use...
+
+		begin = (begin + page_size - 1) / page_size * page_size;
+		end = end / page_size * page_size;
+	}
+	else {
+
+		begin = begin / page_size * page_size;
+		end = (end + page_size - 1) / page_size * page_size;
+
+		if (baked_size < end) end = baked_size;
+	}
+
+	if (end <= begin) return;
+
+	if (madvise(baked_data + begin, end - begin, advice) != 0) {
+		cerr << "ERROR: Failed to advise keyframe residency!" << endl;
+	}
+}
+
+void MD2Model::PrefetchAction(const ActionType& action) {
+
+	int first_frame;
+	int number_of_frames;
+
+	if (GetActionFrames(action, first_frame, number_of_frames) == false) return;
+
+	bool resident = true;
+
+	for (int i = first_frame; i < first_frame + number_of_frames; i++) {
+		resident = resident && resident_frames[i];
+		resident_frames[i] = true;
+	}
+
+	if (resident) return;
+
+	AdviseKeyframes(first_frame, number_of_frames, MADV_WILLNEED);
+}
+
+void MD2Model::AcquireAction(const ActionType& action, const ActionType& previous_action) {
+
+	if (action <= INVALID || ACTION_MAX <= action) return;
+
+	action_users[action]++;
+
+	if (IsResidencyManaged() == false) return;
+
+	// Learn which action follows which...
+
+	if (INVALID < previous_action && previous_action < ACTION_MAX) {
+		action_transitions[previous_action][action]++;
+	}
+
+	PrefetchAction(action);
+
+	// Predict the next action...
+
+	ActionType next_action = IDLE;
+	unsigned int next_action_count = 0;
+
+	for (int b = INVALID + 1; b < ACTION_MAX; b++) {
+
+		if (b == action) continue;
+
+		if (next_action_count < action_transitions[action][b]) {
+			next_action = (ActionType)b;
+			next_action_count = action_transitions[action][b];
+		}
+	}
+
+	if (next_action != action) {
+		
+		PrefetchAction(next_action);
+		
+		// Kept for MD2_RESIDENCY_TIMEOUT, as if released now, otherwise the next eviction drops it unused...
+		
+		if (action_users[next_action] == 0) action_released[next_action] = SDL_GetTicks();
+	}
+}
+
+void MD2Model::ReleaseAction(const ActionType& action) {
+
+	if (action <= INVALID || ACTION_MAX <= action) return;
+
+	assert(action_users[action] > 0);
+
+	action_users[action]--;
+	action_released[action] = SDL_GetTicks();
+}
+
+void MD2Model::EvictActions() {
+
+	const unsigned int now = SDL_GetTicks();
+
+	// Keep keyframes of actions in use or recently released...
+
+	vector<bool> keep(header.numberOfFrames, false);
+
+	for (int a = INVALID + 1; a < ACTION_MAX; a++) {
+
+		if (action_users[a] == 0 && MD2_RESIDENCY_TIMEOUT <= now - action_released[a]) continue;
+
+		int first_frame;
+		int number_of_frames;
+
+		if (GetActionFrames((ActionType)a, first_frame, number_of_frames) == false) continue;
+
+		for (int i = first_frame; i < first_frame + number_of_frames; i++) {
+			keep[i] = true;
+		}
+	}
+
+	// Evict runs of resident keyframes which are not kept...
+
+	int evicted_frames = 0;
+	int frame_index = 0;
+
+	while (frame_index < header.numberOfFrames) {
+
+		if (resident_frames[frame_index] == false || keep[frame_index]) {
+			frame_index++;
+			continue;
+		}
+
+		const int first_frame = frame_index;
+
+		while (frame_index < header.numberOfFrames && resident_frames[frame_index] && keep[frame_index] == false) {
+			resident_frames[frame_index] = false;
+			frame_index++;
+		}
+
+		AdviseKeyframes(first_frame, frame_index - first_frame, MADV_DONTNEED);
+
+		evicted_frames += frame_index - first_frame;
+	}
+
+	if (evicted_frames > 0) {
+		cout << GetModelPath() << ": Evicted keyframes " << evicted_frames << ", resident bytes " << GetResidentKeyframeSize() << endl;
+	}
+}
+
+size_t MD2Model::GetResidentKeyframeSize() {
+
+	if (baked_data == NULL) return 0;
+
+	size_t keyframe_offset;
+	size_t keyframe_size;
+
+	GetKeyframeSection(keyframe_offset, keyframe_size);
+
+	return GetResidentSize(keyframe_offset, keyframe_offset + header.numberOfFrames * keyframe_size);
+}
+
+// ##### Keyframe storage...
+
+/* Note:
+ * KEYFRAME_STORAGE_DECODED keeps 6 floats per vertex per frame (padded to vertexStride),
+ * KEYFRAME_STORAGE_QUANTIZED keeps 4 bytes per vertex per frame, about a sixth of the memory.
+ * A quantized model decodes the current and next keyframe into decoded_buffer when drawn,
+ * each is decoded once while every animation using the model shows the same frames.
+ * Both decode to the same floats, so the storage does not change what is drawn.
+ */
+
+KeyframeStorage MD2Model::default_keyframe_storage = KEYFRAME_STORAGE_DECODED;
+
+void MD2Model::SetDefaultKeyframeStorage(const KeyframeStorage& storage) {
+	default_keyframe_storage = (storage == KEYFRAME_STORAGE_DEFAULT) ? KEYFRAME_STORAGE_DECODED : storage;
+}
+
+string MD2Model::KeyframeStorageToString(const KeyframeStorage& storage) {
+
+	if (storage == KEYFRAME_STORAGE_DECODED)    return "Decoded";
+	if (storage == KEYFRAME_STORAGE_QUANTIZED)  return "Quantized";
+
+	return "Default";
+}
+
+// Normals by md2::Vertex normal index, structure-of-arrays, zero for invalid indices (as when baked)...
+
+struct NormalTable {
+
+	float normals[3][256];
+
+	NormalTable() {
+
+		memset(normals, 0, sizeof(normals));
+
+		for (int i = 0; i < MD2_MAX_NORMALS; i++) {
+			normals[X][i] = md2::NORMALS[i][X];
+			normals[Y][i] = md2::NORMALS[i][Y];
+			normals[Z][i] = md2::NORMALS[i][Z];
+		}
+	}
+};
+
+static const NormalTable normal_table;
+
+void MD2Model::GetKeyframeSection(size_t& offset, size_t& frame_size) {
+
+	const md2c::Header* baked_header = (const md2c::Header*)baked_data;
+
+	if (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED) {
+		offset = baked_header->quantizedVertexOffset;
+		frame_size = header.numberOfVertices * sizeof(md2::Vertex);
+	}
+	else {
+		offset = baked_header->keyframeOffset;
+		frame_size = 6 * vertex_stride * sizeof(float);
+	}
+}
+
+void MD2Model::DecodeKeyframe(const int& frame_index, const int& slot) {
+
+	const md2c::QuantizedFrame& frame = quantized_frames[frame_index];
+	const md2::Vertex* vertices = quantized_vertices + frame_index * header.numberOfVertices;
+
+	md2c::Keyframe& keyframe = decoded_keyframes[slot];
+
+	float* x = (float*)keyframe.positions[X];
+	float* y = (float*)keyframe.positions[Y];
+	float* z = (float*)keyframe.positions[Z];
+
+	float* nx = (float*)keyframe.normals[X];
+	float* ny = (float*)keyframe.normals[Y];
+	float* nz = (float*)keyframe.normals[Z];
+
+	for (int k = 0; k < header.numberOfVertices; k++) {
+
+		const md2::Vertex& vertex = vertices[k];
+
+		x[k] = (frame.scale[X] * vertex.components[X] + frame.translate[X]);
+		y[k] = (frame.scale[Y] * vertex.components[Z] + frame.translate[Y]);
+		z[k] = (frame.scale[Z] * vertex.components[Y] + frame.translate[Z]);
+
+		nx[k] = normal_table.normals[X][vertex.normalIndex];
+		ny[k] = normal_table.normals[Y][vertex.normalIndex];
+		nz[k] = normal_table.normals[Z][vertex.normalIndex];
+	}
+
+	decoded_frame_indices[slot] = frame_index;
+}
+
+void MD2Model::GetKeyframes(const int& current_frame_index, const int& next_frame_index, md2c::Keyframe& current_frame, md2c::Keyframe& next_frame) {
+
+	if (keyframe_storage != KEYFRAME_STORAGE_QUANTIZED) {
+		current_frame = keyframes[current_frame_index];
+		next_frame = keyframes[next_frame_index];
+		return;
+	}
+
+	// Reuse a decoded keyframe, otherwise decode into the slot the other keyframe is not using...
+
+	int current_slot = -1;
+	int next_slot = -1;
+
+	for (int slot = 0; slot < 2; slot++) {
+		if (decoded_frame_indices[slot] == current_frame_index) current_slot = slot;
+		if (decoded_frame_indices[slot] == next_frame_index) next_slot = slot;
+	}
+
+	if (current_slot < 0) {
+		current_slot = (next_slot == 0) ? 1 : 0;
+		DecodeKeyframe(current_frame_index, current_slot);
+	}
+
+	if (current_frame_index == next_frame_index) next_slot = current_slot; // Decoded once
+
+	if (next_slot < 0) {
+		next_slot = 1 - current_slot;
+		DecodeKeyframe(next_frame_index, next_slot);
+	}
+
+	current_frame = decoded_keyframes[current_slot];
+	next_frame = decoded_keyframes[next_slot];
+}
+
+size_t MD2Model::GetResidentSize(const size_t& begin, const size_t& end) {
+
+	if (end <= begin) return 0;
+
+	if (baked_mapped == false) return end - begin; // Heap: always resident
+
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	const size_t page_begin = begin / page_size * page_size;
+
+	const size_t number_of_pages = (end - page_begin + page_size - 1) / page_size;
+
+	vector<unsigned char> pages(number_of_pages);
+
+	if (mincore(baked_data + page_begin, end - page_begin, &pages[0]) != 0) return 0;
+
+	size_t resident_size = 0;
+
+	for (size_t i = 0; i < number_of_pages; i++) {
+		if (pages[i] & 1) resident_size += page_size;
+	}
+
+	return resident_size;
+}
+
+size_t MD2Model::GetKeyframeSize() {
+
+	if (baked_data == NULL) return 0;
+
+	size_t keyframe_offset;
+	size_t keyframe_size;
+
+	GetKeyframeSection(keyframe_offset, keyframe_size);
+
+	size_t size = header.numberOfFrames * keyframe_size;
+
+	if (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED) {
+		size += header.numberOfFrames * sizeof(md2c::QuantizedFrame);
+		size += 2 * 6 * vertex_stride * sizeof(float); // Decoded keyframes
+	}
+	else {
+		size += header.numberOfFrames * sizeof(md2c::Keyframe);
+	}
+
+	return size;
+}
+
+size_t MD2Model::GetMemorySize() {
+
+	if (baked_data == NULL) return 0;
+
+	size_t size = baked_size;
+
+	if (baked_mapped) {
+
+		// Pages of the keyframes the model does not use are never touched, even if the file is cached...
+
+		const md2c::Header* baked_header = (const md2c::Header*)baked_data;
+
+		size = GetResidentSize(0, baked_header->quantizedFrameOffset);
+
+		if (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED) {
+			size += GetResidentSize(baked_header->quantizedFrameOffset, baked_header->quantizedVertexOffset);
+		}
+		else {
+			size += GetResidentSize(baked_header->quantizedVertexOffset, baked_header->keyframeOffset); // Normal indices
+		}
+
+		size += GetResidentKeyframeSize();
+	}
+
+	// Not part of the baked data...
+
+	size += 6 * vertex_stride * sizeof(float); // Pose
+
+	if (keyframe_storage == KEYFRAME_STORAGE_QUANTIZED) {
+		size += 2 * 6 * vertex_stride * sizeof(float);
+	}
+	else {
+		size += header.numberOfFrames * sizeof(md2c::Keyframe);
+	}
+
+	for (int i = 0; i < MESH_PATH_MAX; i++) {
+		size += streams[i].vertex_indices.capacity() * sizeof(int);
+		size += streams[i].texture_coordinates.capacity() * sizeof(float);
+		size += streams[i].triangle_indices.capacity() * sizeof(unsigned short);
+		
+		for (int depth = 0; depth <= SUBDIVISION_MAX_DEPTH; depth++) {
+			
+			const SubdivisionTopology& topology = streams[i].subdivision_topologies[depth];
+			
+			size += topology.vertices.capacity() * sizeof(SubdividedVertex);
+			size += topology.texture_coordinates.capacity() * sizeof(float);
+			size += topology.triangle_indices.capacity() * sizeof(unsigned int);
+		}
+	}
+
+	return size;
+}
@@ -1,12 +1,22 @@
 #include "Process.hpp"
+#include "Profiler.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <set>
 #include <cassert>
 
-#include <SDL2/SDL.h> // SDL_GetTicks
+#include <SDL2/SDL.h> // SDL_GetPerformanceCounter, SDL_Delay
 
 ProcessManager engine("engine");
 
+unsigned int NextSystemSlot() {
+	
+	static SDL_atomic_t next_slot; // Zero before any constructor runs
+	
+	return SDL_AtomicAdd(&next_slot, 1);
+}
+
 bool operator< (const System& a, const System& b) {
 	return (typeid(a).before(typeid(b)));
 }
@@ -15,30 +25,232 @@ bool operator== (const System& a, const System& b) {
 	return (typeid(a) == typeid(b));
 }
 
-ProcessManager::ProcessManager(const string& name) : System(name) {
+static bool CompareSystemNames(const pair<const type_info*, System*>& a, const pair<const type_info*, System*>& b) {
+	return a.second->Name() < b.second->Name();
+}
+
+static Uint64 GetClockNanoseconds() {
+
+	// Monotonic, unlike the wall clock...
+
+	static const Uint64 frequency = SDL_GetPerformanceFrequency();
+
+	const Uint64 counter = SDL_GetPerformanceCounter();
+
+	// Split, so the counter times 10^9 cannot overflow...
+
+	return (counter / frequency) * 1000000000 + (counter % frequency) * 1000000000 / frequency;
+}
+
+static void WaitUntil(const Uint64& nanoseconds) {
+
+	/* Note:
+	 * Sleeps most of the time left, which is what frees the CPU,
+	 * but a sleep may last a millisecond or so longer than asked,
+	 * so the last millisecond is spun.
+	 */
+
+	const Uint64 now = GetClockNanoseconds();
+
+	if (now >= nanoseconds) return;
+
+	const Uint64 milliseconds_left = (nanoseconds - now) / 1000000;
+
+	if (milliseconds_left > ENGINE_SPIN_MILLISECONDS) {
+		SDL_Delay((Uint32)(milliseconds_left - ENGINE_SPIN_MILLISECONDS));
+	}
+
+	while (GetClockNanoseconds() < nanoseconds) {}
+}
+
+ProcessManager::ProcessManager(const string& name) : System(name),
+		is_deleting_systems(false),
+		is_schedule_valid(false),
+		clock_milliseconds(0),
+		simulation_milliseconds(0),
+		step_alpha(0.0f),
+		frame_limit(ENGINE_FRAME_LIMIT) {
 }
 
 ProcessManager::~ProcessManager() {
 	
+	// ##### Resources...
+	
+	// First: resources may use systems as they are deleted (eg. an Animation leaves the Animator)
+	
+	ClearResources();
+	
 	// ##### Systems...
 	
-	for (SystemMap::iterator itr = systems.begin(); itr != systems.end(); itr++) {
+	// Last registered, first deleted: a system may use the systems registered before it until it is deleted
+	// Each is unlisted before it is deleted, so the systems deleted after it find NULL rather than a dangling system
+	
+	is_deleting_systems = true;
+	
+	for (unsigned int i = registered_systems.size(); i > 0; i--) {
+		
+		System* system = registered_systems[i - 1];
+		
+		systems.erase(&typeid(*system));
+		replace(system_slots.begin(), system_slots.end(), system, (System*)NULL);
 		
-		System* system = itr->second;
 		delete system;
 	}
 	
+	registered_systems.clear();
+	system_slots.clear();
 	systems.clear();
+}
+
+void ProcessManager::Schedule() {
+
+	/* Note:
+	 * Kahn's algorithm, one wave at a time:
+	 * a wave holds every system whose dependencies are all in earlier waves (or are not systems yet).
+	 * Within a wave, systems are ordered by name (their type), so the order does not depend on when they were created.
+	 */
+
+	schedule.clear();
+
+	vector<pair<const type_info*, System*> > remaining(systems.begin(), systems.end());
+
+	sort(remaining.begin(), remaining.end(), CompareSystemNames);
+
+	set<const type_info*> scheduled_types;
+
+	while (remaining.empty() == false) {
+
+		SystemList wave;
+		vector<const type_info*> wave_types;
+		vector<pair<const type_info*, System*> > blocked;
+
+		for (unsigned int i = 0; i < remaining.size(); i++) {
+
+			System* system = remaining[i].second;
+
+			bool is_ready = true;
+
+			for (unsigned int d = 0; d < system->dependencies.size(); d++) {
+
+				const type_info* dependency = system->dependencies[d];
+
+				if (ContainsSystem(dependency) && scheduled_types.count(dependency) == 0) {
+					is_ready = false;
+					break;
+				}
+			}
+
+			if (is_ready) {
+				wave.push_back(system);
+				wave_types.push_back(remaining[i].first);
+			} else {
+				blocked.push_back(remaining[i]);
+			}
+		}
+
+		if (wave.empty()) {
+
+			cerr << "ERROR: Systems depend on each other, updating them in name order!" << endl;
+
+			for (unsigned int i = 0; i < blocked.size(); i++) {
+				schedule.push_back(SystemList(1, blocked[i].second));
+			}
+
+			break;
+		}
+
+		scheduled_types.insert(wave_types.begin(), wave_types.end());
+
+		schedule.push_back(wave);
+		remaining.swap(blocked);
+	}
+
+	// New systems start their clock now...
+
+	for (SystemMap::iterator itr = systems.begin(); itr != systems.end(); itr++) {
+
+		System* system = itr->second;
+
+		if (system->is_scheduled) continue;
+
+		const unsigned int milliseconds = system->fixed_step ? simulation_milliseconds : clock_milliseconds;
+
+		system->is_scheduled = true;
+		system->last_tick_milliseconds = milliseconds;
+		system->next_tick_milliseconds = milliseconds;
+	}
+
+	is_schedule_valid = true;
+}
+
+bool ProcessManager::IsDue(System* system, const unsigned int& milliseconds, unsigned int& elapsed_milliseconds) {
+
+	if (system->IsRunning() == false) return false;
+	if (system->ticks_per_second == SYSTEM_TICK_NEVER) return false;
+
+	if (system->ticks_per_second > 0) {
+
+		if ((int)(milliseconds - system->next_tick_milliseconds) < 0) return false;
+
+		const unsigned int interval = 1000 / system->ticks_per_second;
+
+		system->next_tick_milliseconds += interval;
+
+		// Fell behind (eg. a long frame), skip the missed ticks instead of catching up...
+
+		if ((int)(milliseconds - system->next_tick_milliseconds) >= 0) {
+			system->next_tick_milliseconds = milliseconds + interval;
+		}
+	}
+
+	elapsed_milliseconds = milliseconds - system->last_tick_milliseconds;
+	system->last_tick_milliseconds = milliseconds;
+
+	return true;
+}
+
+void ProcessManager::RunSystems(const bool& is_fixed_step, const unsigned int& milliseconds) {
 	
-	// ##### Resources...
+	/* Note:
+	 * Systems update in waves, in dependency order (see Schedule), and only when due (see IsDue).
+	 * Each system is given the time elapsed since it last updated, on the clock of its phase:
+	 * the simulation clock for fixed step systems (see Step), the frame clock for the rest.
+	 */
+	
+	if (is_schedule_valid == false) Schedule();
 	
-	for (ResourceList::iterator itr = resources.begin(); itr != resources.end(); itr++) {
+	for (unsigned int w = 0; w < schedule.size(); w++) {
+		
+		if (IsRunning() == false) break;
+		
+		const SystemList& wave = schedule[w];
 		
-		Resource* resource = (*itr);
-		delete resource;
+		for (unsigned int i = 0; i < wave.size(); i++) {
+			
+			if (IsRunning() == false) break;
+			
+			System* system = wave[i];
+			
+			if (system->IsFixedStep() != is_fixed_step) continue;
+			
+			unsigned int elapsed_milliseconds;
+			
+			if (IsDue(system, milliseconds, elapsed_milliseconds) == false) continue;
+			
+			PROFILE_ZONE(typeid(*system).name());
+			
+			system->Update(elapsed_milliseconds);
+		}
 	}
+}
+
+void ProcessManager::Step() {
+	
+	PROFILE_ZONE("ProcessManager::Step");
 	
-	resources.clear();
+	simulation_milliseconds += ENGINE_STEP_MILLISECONDS;
+	
+	RunSystems(true, simulation_milliseconds);
 }
 
 void ProcessManager::Update(const unsigned int& elapsed_milliseconds) {
@@ -51,52 +263,127 @@ void ProcessManager::Update(const unsigned int& elapsed_milliseconds) {
 	 * When a System updates, the System MUST call Resource::Touch().
 	 */
 	
-	for (SystemMap::iterator itr = systems.begin(); itr != systems.end(); itr++) {
-		
-		if (IsRunning() == false) break;
-
-		System* system = itr->second;
-
-		if (system->IsRunning() == false) continue;
-
-		system->Update(elapsed_milliseconds);
-	}
+	clock_milliseconds += elapsed_milliseconds;
+	
+	RunSystems(false, clock_milliseconds);
 	
 	// ##### Resources...
 	
 	/* Note:
 	 * If a system failed to touch a Resource,
 	 * The Resource is deallocated.
+	 * A Resource inserted during the frame may have missed the systems, it is checked from the next frame.
 	 */
 	
-	for (ResourceList::iterator itr = resources.begin(); itr != resources.end(); itr++) {
+	PROFILE_ZONE("ProcessManager::Resources");
+	
+	for (unsigned int i = 0; i < resources.Size(); i++) {
 		
 		if (IsRunning() == false) break;
 		
-		Resource* resource = (*itr);
+		Resource* resource = resources.At(i);
+		
+		if (resource->is_new) {
+			resource->is_new = false;
+			continue;
+		}
 		
 		if (resource->IsTouched()) continue;
 		
 		cerr << "ERROR: Resource " << resource->Name() << " never touched!" << endl;
 		
-		delete resource;
-		resources.erase(itr);
+		DestroyResource(resources.HandleAt(i));
 	}
+	
+	// Safe point: no system is iterating the resources...
+	
+	DeleteDestroyedResources();
 }
 
 void ProcessManager::Start() {
 	
 	System::Start();
 
-	unsigned int last_milliseconds = SDL_GetTicks();
+	Schedule();
+	ReportSchedule();
+
+	/* Note:
+	 * Fixed step loop, on a nanosecond clock:
+	 * - The elapsed time of each frame is added to an accumulator, which is spent in steps of ENGINE_STEP_MILLISECONDS:
+	 *   fixed step systems (eg. Animator) always advance by the same amount, however fast the frames are,
+	 *   so the simulation only depends on the number of steps
+	 * - What is left in the accumulator is the step alpha: render interpolates between the last two steps with it
+	 * - After a stall (eg. loading, a breakpoint), at most ENGINE_MAX_STEPS are run: the rest is dropped,
+	 *   rather than spending the next frames catching up (and falling further behind)
+	 * - Frame systems are given whole milliseconds, the remainder is carried to the next frame
+	 */
+
+	const Uint64 step_nanoseconds = (Uint64)ENGINE_STEP_MILLISECONDS * 1000000;
+
+	Uint64 last_nanoseconds = GetClockNanoseconds();
+	Uint64 step_nanoseconds_left = 0;
+	Uint64 frame_nanoseconds_left = 0;
 
 	while (IsRunning()) {
 
-		unsigned int milliseconds = SDL_GetTicks();
-		unsigned int elapsed_milliseconds = milliseconds - last_milliseconds;
-		last_milliseconds = milliseconds;
-		
+		PROFILE_ZONE("Frame");
+
+		const Uint64 frame_start_nanoseconds = GetClockNanoseconds();
+		const Uint64 elapsed_nanoseconds = frame_start_nanoseconds - last_nanoseconds;
+		last_nanoseconds = frame_start_nanoseconds;
+
+		// ##### Simulation...
+
+		step_nanoseconds_left += elapsed_nanoseconds;
+
+		if (step_nanoseconds_left > ENGINE_MAX_STEPS * step_nanoseconds) {
+			step_nanoseconds_left = ENGINE_MAX_STEPS * step_nanoseconds;
+		}
+
+		while (step_nanoseconds_left >= step_nanoseconds && IsRunning()) {
+			Step();
+			step_nanoseconds_left -= step_nanoseconds;
+		}
+
+		step_alpha = (float)step_nanoseconds_left / (float)step_nanoseconds;
+
+		// ##### Frame...
+
+		frame_nanoseconds_left += elapsed_nanoseconds;
+
+		const unsigned int elapsed_milliseconds = (unsigned int)(frame_nanoseconds_left / 1000000);
+		frame_nanoseconds_left -= (Uint64)elapsed_milliseconds * 1000000;
+
 		Update(elapsed_milliseconds);
+
+		// ##### Frame limit...
+
+		if (frame_limit > 0) {
+			PROFILE_ZONE("Frame limit");
+			WaitUntil(frame_start_nanoseconds + 1000000000 / frame_limit);
+		}
+	}
+}
+
+void ProcessManager::CycleFrameLimit() {
+
+	// Off, then common refresh rates...
+
+	static const unsigned int limits[] = { 0, 30, 60, 120, 144 };
+	static const unsigned int number_of_limits = sizeof(limits) / sizeof(limits[0]);
+
+	unsigned int next = 0;
+
+	for (unsigned int i = 0; i < number_of_limits; i++) {
+		if (limits[i] == frame_limit) next = (i + 1) % number_of_limits;
+	}
+
+	frame_limit = limits[next];
+
+	if (frame_limit > 0) {
+		cout << "Frame limit " << frame_limit << " fps" << endl;
+	} else {
+		cout << "Frame limit off" << endl;
 	}
 }
 
@@ -104,7 +391,7 @@ bool ProcessManager::ContainsSystem(const type_info* system_type) {
 	return (systems.find(system_type) != systems.end());
 }
 
-bool ProcessManager::InsertSystem(const type_info* system_type, System* system) {
+bool ProcessManager::InsertSystem(const type_info* system_type, const unsigned int& slot, System* system) {
 	
 	if (ContainsSystem(system_type)) {
 		cerr << "ERROR: already contains process!" << endl;
@@ -113,9 +400,20 @@ bool ProcessManager::InsertSystem(const type_info* system_type, System* system)
 
 	systems[system_type] = system;
 
+	if (slot >= system_slots.size()) system_slots.resize(slot + 1, NULL);
+
+	system_slots[slot] = system;
+	registered_systems.push_back(system);
+
+	is_schedule_valid = false;
+
 	return true;
 }
 
+void ProcessManager::ReportUnregisteredSystem(const type_info* system_type) {
+	cerr << "ERROR: System " << system_type->name() << " used before it was registered, registering it now!" << endl;
+}
+
 System* ProcessManager::FindSystem(const type_info* system_type) {
 	
 	SystemMap::iterator results = systems.find(system_type);
@@ -126,6 +424,473 @@ System* ProcessManager::FindSystem(const type_info* system_type) {
 	return system;
 }
 
+ResourceHandle ProcessManager::InsertResource(Resource* resource) {
+	
+	assert(resource != NULL);
+	
+	return resources.Insert(resource);
+}
+
+Resource* ProcessManager::FindResource(const ResourceHandle& handle) {
+	
+	Resource** resource = resources.Find(handle);
+	
+	if (resource == NULL) return NULL;
+	
+	return *resource;
+}
+
+void ProcessManager::DestroyResource(const ResourceHandle& handle) {
+	destroyed_resources.push_back(handle);
+}
+
+void ProcessManager::DeleteDestroyedResources() {
+	
+	for (unsigned int i = 0; i < destroyed_resources.size(); i++) {
+		
+		Resource** resource = resources.Find(destroyed_resources[i]);
+		
+		if (resource == NULL) continue; // Destroyed twice
+		
+		delete *resource;
+		resources.Remove(destroyed_resources[i]);
+	}
+	
+	destroyed_resources.clear();
+}
+
+void ProcessManager::ClearResources() {
+	
+	destroyed_resources.clear();
+	
+	for (unsigned int i = 0; i < resources.Size(); i++) {
+		delete resources.At(i);
+	}
+	
+	resources.Clear();
+}
+
 ResourceList* ProcessManager::Resources() {
 	return &resources;
 }
+
+void ProcessManager::ReportSchedule() {
+
+	if (is_schedule_valid == false) Schedule();
+
+	for (unsigned int w = 0; w < schedule.size(); w++) {
+
+		cout << "Wave " << w << ":";
+
+		for (unsigned int i = 0; i < schedule[w].size(); i++) {
+
+			System* system = schedule[w][i];
+
+			cout << " " << system->Name() << " (";
+
+			if (system->GetTickRate() == SYSTEM_TICK_NEVER) {
+				cout << "never";
+			} else if (system->GetTickRate() == SYSTEM_TICK_ALWAYS) {
+				cout << "always";
+			} else {
+				cout << system->GetTickRate() << " Hz";
+			}
+
+			if (system->IsFixedStep()) cout << ", fixed step";
+
+			cout << ")";
+		}
+
+		cout << endl;
+	}
+}
+
+// ##### Checks...
+
+/* Note:
+ * CheckEngine runs engines of its own (not the global engine) with check systems and resources,
+ * which record what was done to them.
+ */
+
+class CheckSystem : public System {
+
+	public:
+
+		static ProcessManager* manager;     // Of the check systems
+		static vector<System*> updated;     // In update order
+		static vector<System*> deleted;     // In delete order
+		static vector<const type_info*> deleted_types;
+		static bool found_deleted;          // A system looked up a system deleted before it
+
+		const type_info* type;
+		unsigned int slot;
+
+		vector<unsigned int> elapsed;       // Of each update
+
+		CheckSystem(const string& name) : System(name), type(NULL), slot(0) {}
+
+		~CheckSystem() {
+
+			for (unsigned int i = 0; i < deleted_types.size(); i++) {
+				if (manager->FindSystem(deleted_types[i]) != NULL) found_deleted = true;
+			}
+
+			if (manager->FindSystem(type) != NULL || manager->FindSystem(slot) != NULL) found_deleted = true;
+
+			deleted.push_back(this);
+			deleted_types.push_back(type);
+		}
+
+	protected:
+
+		void Update(const unsigned int& elapsed_milliseconds) {
+			elapsed.push_back(elapsed_milliseconds);
+			updated.push_back(this);
+		}
+};
+
+ProcessManager* CheckSystem::manager = NULL;
+vector<System*> CheckSystem::updated;
+vector<System*> CheckSystem::deleted;
+vector<const type_info*> CheckSystem::deleted_types;
+bool CheckSystem::found_deleted = false;
+
+class CheckFirst : public CheckSystem {
+	public:
+		CheckFirst(const string& name) : CheckSystem(name) {}
+};
+
+class CheckSecond : public CheckSystem {
+	public:
+		CheckSecond(const string& name) : CheckSystem(name) { RunAfter(&typeid(CheckFirst)); }
+};
+
+class CheckTicked : public CheckSystem {
+	public:
+		CheckTicked(const string& name) : CheckSystem(name) { SetTickRate(10); }
+};
+
+class CheckStepped : public CheckSystem {
+	public:
+		CheckStepped(const string& name) : CheckSystem(name) { SetFixedStep(true); }
+};
+
+class CheckStopper : public System { // Stops its engine after a second of frames
+
+	public:
+
+		ProcessManager* manager;
+		unsigned int frames;
+		unsigned int clock_milliseconds;
+
+		CheckStopper(const string& name) : System(name), manager(NULL), frames(0), clock_milliseconds(0) {}
+
+	protected:
+
+		void Update(const unsigned int& elapsed_milliseconds) {
+
+			frames++;
+			clock_milliseconds += elapsed_milliseconds;
+
+			if (clock_milliseconds >= 1000) manager->Stop();
+		}
+};
+
+class CheckResource : public Resource {
+
+	public:
+
+		static unsigned int number_deleted;
+
+		CheckResource() : Resource("check") { Touch(); } // Never swept as untouched
+		~CheckResource() { number_deleted++; }
+
+	protected:
+
+		void Update(const unsigned int&) {}
+};
+
+unsigned int CheckResource::number_deleted = 0;
+
+class EngineCheck { // Friend of ProcessManager, to run frames one at a time
+
+	public:
+
+		static void Frame(ProcessManager& manager, const unsigned int& elapsed_milliseconds) {
+			manager.Update(elapsed_milliseconds);
+		}
+};
+
+template<typename S>
+static S* InsertCheckSystem(ProcessManager& manager) {
+
+	S* system = new S(typeid(S).name());
+
+	system->type = &typeid(S);
+	system->slot = SystemSlot<S>();
+
+	manager.InsertSystem(system->type, system->slot, system);
+
+	return system;
+}
+
+static bool Check(const bool& passed, const string& description) {
+
+	cout << "Check " << description << (passed ? "" : " FAILED") << endl;
+
+	if (passed == false) cerr << "ERROR: Check " << description << " failed!" << endl;
+
+	return passed;
+}
+
+static unsigned int NextCheckRandom(unsigned int& seed) {
+
+	seed = seed * 1664525 + 1013904223; // Deterministic, unlike rand
+
+	return seed >> 8;
+}
+
+static bool CheckSlotMap() {
+
+	// Random inserts and removes, against a map...
+
+	#define CHECK_SLOT_MAP_OPERATIONS   (200000)
+
+	SlotMap<int> slot_map;
+	map<unsigned int, pair<SlotHandle, int> > expected; // By insert order
+
+	vector<SlotHandle> stale_handles;
+
+	unsigned int seed = 1;
+	unsigned int inserts = 0;
+
+	bool passed = true;
+
+	for (unsigned int i = 0; i < CHECK_SLOT_MAP_OPERATIONS && passed; i++) {
+
+		const unsigned int operation = NextCheckRandom(seed) % 3;
+
+		if (operation < 2 || expected.empty()) {
+
+			const SlotHandle handle = slot_map.Insert(inserts);
+
+			expected[inserts] = make_pair(handle, (int)inserts);
+			inserts++;
+
+		} else {
+
+			map<unsigned int, pair<SlotHandle, int> >::iterator item = expected.lower_bound(NextCheckRandom(seed) % inserts);
+
+			if (item == expected.end()) item = expected.begin();
+
+			passed = passed && slot_map.Remove(item->second.first);
+			passed = passed && (slot_map.Remove(item->second.first) == false);
+
+			stale_handles.push_back(item->second.first);
+			expected.erase(item);
+		}
+
+		if (stale_handles.empty() == false) {
+			passed = passed && (slot_map.Find(stale_handles[NextCheckRandom(seed) % stale_handles.size()]) == NULL);
+		}
+	}
+
+	passed = passed && (slot_map.Size() == expected.size());
+
+	for (map<unsigned int, pair<SlotHandle, int> >::iterator item = expected.begin(); item != expected.end() && passed; item++) {
+
+		const int* value = slot_map.Find(item->second.first);
+
+		passed = (value != NULL) && (*value == item->second.second);
+	}
+
+	for (unsigned int i = 0; i < slot_map.Size() && passed; i++) {
+		passed = (slot_map.Find(slot_map.HandleAt(i)) == &slot_map.At(i));
+	}
+
+	return Check(passed, "slot map: random inserts and removes match a map, stale handles are rejected");
+}
+
+static bool CheckResources() {
+
+	// Destroyed at the end of the frame, once, however many times they are destroyed...
+
+	#define CHECK_RESOURCES (1000)
+
+	bool passed = true;
+
+	CheckResource::number_deleted = 0;
+
+	{
+		ProcessManager manager("check");
+
+		vector<ResourceHandle> handles;
+
+		for (unsigned int i = 0; i < CHECK_RESOURCES; i++) {
+			handles.push_back(manager.InsertResource(new CheckResource()));
+		}
+
+		EngineCheck::Frame(manager, 10);
+
+		for (unsigned int i = 0; i < CHECK_RESOURCES; i += 2) {
+			manager.DestroyResource(handles[i]);
+			manager.DestroyResource(handles[i]);
+		}
+
+		passed = passed && (manager.FindResource(handles[0]) != NULL) && (CheckResource::number_deleted == 0);
+
+		EngineCheck::Frame(manager, 10);
+
+		for (unsigned int i = 0; i < CHECK_RESOURCES; i++) {
+			passed = passed && ((manager.FindResource(handles[i]) == NULL) == (i % 2 == 0));
+		}
+
+		passed = passed && (CheckResource::number_deleted == CHECK_RESOURCES / 2);
+		passed = passed && (manager.Resources()->Size() == CHECK_RESOURCES / 2);
+	}
+
+	passed = passed && (CheckResource::number_deleted == CHECK_RESOURCES);
+
+	return Check(passed, "resources: destroyed at the end of the frame, once, and the rest with the engine");
+}
+
+static bool CheckSchedule() {
+
+	bool passed = true;
+
+	CheckSystem::updated.clear();
+	CheckSystem::deleted.clear();
+	CheckSystem::deleted_types.clear();
+	CheckSystem::found_deleted = false;
+
+	vector<System*> registered;
+
+	{
+		ProcessManager manager("check");
+
+		CheckSystem::manager = &manager;
+
+		// Registered out of dependency order...
+
+		registered.push_back(InsertCheckSystem<CheckStepped>(manager));
+		registered.push_back(InsertCheckSystem<CheckTicked>(manager));
+		registered.push_back(InsertCheckSystem<CheckSecond>(manager));
+		registered.push_back(InsertCheckSystem<CheckFirst>(manager));
+
+		CheckSystem* stepped    = (CheckSystem*)registered[0];
+		CheckSystem* ticked     = (CheckSystem*)registered[1];
+		CheckSystem* second     = (CheckSystem*)registered[2];
+		CheckSystem* first      = (CheckSystem*)registered[3];
+
+		// Scheduled at 0 ms, then a second of 10 ms frames, with a step before each...
+
+		EngineCheck::Frame(manager, 0);
+
+		bool ordered = true;
+
+		for (unsigned int frame = 0; frame < 100; frame++) {
+
+			CheckSystem::updated.clear();
+
+			manager.Step();
+			EngineCheck::Frame(manager, 10);
+
+			const vector<System*>& updated = CheckSystem::updated;
+
+			const size_t first_index = find(updated.begin(), updated.end(), first) - updated.begin();
+			const size_t second_index = find(updated.begin(), updated.end(), second) - updated.begin();
+
+			ordered = ordered && (updated.empty() == false) && (updated[0] == stepped) && (first_index < second_index) && (second_index < updated.size());
+		}
+
+		passed = Check(ordered, "schedule: fixed step systems first, then each system after the systems it runs after") && passed;
+
+		// 10 Hz: a tick when first scheduled, then every 100 ms...
+
+		bool ticked_on_time = (ticked->elapsed.size() == 11);
+
+		for (unsigned int i = 1; i < ticked->elapsed.size(); i++) {
+			ticked_on_time = ticked_on_time && (ticked->elapsed[i] == 100);
+		}
+
+		passed = Check(ticked_on_time, "schedule: a 10 Hz system updates every 100 ms and is given that time") && passed;
+
+		// Fixed step: once per step, a whole number of steps...
+
+		bool stepped_whole = (stepped->elapsed.size() == 100);
+
+		for (unsigned int i = 0; i < stepped->elapsed.size(); i++) {
+			stepped_whole = stepped_whole && (stepped->elapsed[i] == ENGINE_STEP_MILLISECONDS);
+		}
+
+		passed = Check(stepped_whole, "schedule: a fixed step system updates once per step and is given the step") && passed;
+	}
+
+	// Deleted in reverse registration order...
+
+	const vector<System*>& deleted = CheckSystem::deleted;
+
+	passed = Check(deleted.size() == registered.size() && equal(deleted.begin(), deleted.end(), registered.rbegin()),
+		"systems: deleted in the reverse order they were registered in") && passed;
+
+	passed = Check(CheckSystem::found_deleted == false, "systems: a deleted system is not found by the systems deleted after it") && passed;
+
+	CheckSystem::manager = NULL;
+
+	return passed;
+}
+
+static bool CheckFrameLimit() {
+
+	// A second of frames at 60 fps: fewer frames, the same simulation...
+
+	unsigned int frames;
+	unsigned int clock_milliseconds;
+	unsigned int simulation_milliseconds;
+
+	{
+		ProcessManager manager("check");
+
+		CheckSystem::manager = &manager;
+
+		CheckStopper* stopper = new CheckStopper(typeid(CheckStopper).name());
+
+		stopper->manager = &manager;
+
+		manager.InsertSystem(&typeid(CheckStopper), SystemSlot<CheckStopper>(), stopper);
+
+		CheckStepped* stepped = InsertCheckSystem<CheckStepped>(manager);
+
+		manager.SetFrameLimit(60);
+		manager.Start();
+
+		frames = stopper->frames;
+		clock_milliseconds = stopper->clock_milliseconds;
+		simulation_milliseconds = stepped->elapsed.size() * ENGINE_STEP_MILLISECONDS;
+	}
+
+	CheckSystem::manager = NULL;
+
+	cout << "Check frame limit 60 fps: frames " << frames << ", simulation " << simulation_milliseconds << " ms in " << clock_milliseconds << " ms" << endl;
+
+	bool passed = true;
+
+	passed = Check(frames <= 61, "frame limit: at most 60 frames per second") && passed;
+	passed = Check(simulation_milliseconds <= clock_milliseconds && clock_milliseconds < simulation_milliseconds + ENGINE_STEP_MILLISECONDS,
+		"fixed step: the simulation keeps up with the frame clock under a frame limit") && passed;
+
+	return passed;
+}
+
+bool CheckEngine() {
+
+	bool passed = true;
+
+	passed = CheckSlotMap() && passed;
+	passed = CheckResources() && passed;
+	passed = CheckSchedule() && passed;
+	passed = CheckFrameLimit() && passed;
+
+	return passed;
+}
+
@@ -0,0 +1,259 @@
+#include "Profiler.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+
+#include <cctype>
+#include <cstdlib>
+
+#include <cxxabi.h> // abi::__cxa_demangle, see ZoneName
+
+using namespace std;
+
+// Every buffer, in the order threads first recorded a zone, published once filled in...
+
+static ProfileBuffer* buffers[PROFILER_MAX_THREADS];
+static SDL_atomic_t number_of_buffers;
+
+// The buffer of the calling thread...
+
+static __thread ProfileBuffer* thread_buffer = NULL;
+static __thread bool is_thread_ignored = false; // Past PROFILER_MAX_THREADS
+
+ProfileBuffer* Profiler::GetThreadBuffer() {
+
+	if (thread_buffer != NULL || is_thread_ignored) return thread_buffer;
+
+	const int thread_index = SDL_AtomicAdd(&number_of_buffers, 1);
+
+	if (thread_index >= PROFILER_MAX_THREADS) {
+		is_thread_ignored = true;
+		return NULL;
+	}
+
+	ProfileBuffer* buffer = new ProfileBuffer();
+
+	buffer->written = 0;
+	buffer->thread_name = NULL;
+	buffer->thread_index = thread_index;
+
+	thread_buffer = buffer;
+
+	SDL_AtomicSetPtr((void**)&buffers[thread_index], buffer);
+
+	return buffer;
+}
+
+void Profiler::Record(const char* name, const Uint64& start_ticks, const Uint64& end_ticks) {
+
+	ProfileBuffer* buffer = GetThreadBuffer();
+
+	if (buffer == NULL) return;
+
+	const unsigned int written = buffer->written;
+
+	ProfileEvent& event = buffer->events[written & (PROFILER_EVENTS_PER_THREAD - 1)];
+
+	event.name = name;
+	event.start_ticks = start_ticks;
+	event.end_ticks = end_ticks;
+
+	// Counted once written, see Export...
+
+	SDL_MemoryBarrierRelease();
+	buffer->written = written + 1;
+}
+
+void Profiler::SetThreadName(const char* name) {
+
+	ProfileBuffer* buffer = GetThreadBuffer();
+
+	if (buffer != NULL) buffer->thread_name = name;
+}
+
+bool Profiler::IsEnabled() {
+#ifdef PROFILER_ENABLED
+	return true;
+#else
+	return false;
+#endif
+}
+
+static string ZoneName(const char* name) {
+
+	// Zones of systems are named by type (typeid), eg. "5Video"...
+
+	if (isdigit(name[0]) == false) return name;
+
+	int status = 0;
+
+	char* demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+
+	if (status != 0 || demangled == NULL) return name;
+
+	const string zone_name = demangled;
+
+	free(demangled);
+
+	return zone_name;
+}
+
+static string EscapeJSON(const string& text) {
+
+	string escaped;
+
+	for (unsigned int i = 0; i < text.size(); i++) {
+
+		if (text[i] == '"' || text[i] == '\\') escaped += '\\';
+
+		escaped += text[i];
+	}
+
+	return escaped;
+}
+
+bool Profiler::Export(const string& path) {
+
+	if (IsEnabled() == false) {
+		cerr << "ERROR: Profiler is compiled out (build with make PROFILE=1)!" << endl;
+		return false;
+	}
+
+	// ##### Copy the events of every thread...
+
+	/* Note:
+	 * Threads keep recording while their buffer is copied,
+	 * so the oldest events may be overwritten during the copy:
+	 * those are dropped, by comparing the events written before and after the copy.
+	 */
+
+	int number_of_threads = SDL_AtomicGet(&number_of_buffers);
+
+	if (number_of_threads > PROFILER_MAX_THREADS) number_of_threads = PROFILER_MAX_THREADS;
+
+	vector<ProfileBuffer*> thread_buffers;
+	vector<vector<ProfileEvent> > thread_events;
+
+	Uint64 first_ticks = 0;
+	bool is_first = true;
+
+	unsigned int number_of_events = 0;
+
+	for (int t = 0; t < number_of_threads; t++) {
+
+		ProfileBuffer* buffer = (ProfileBuffer*)SDL_AtomicGetPtr((void**)&buffers[t]);
+
+		if (buffer == NULL) continue; // Not published yet
+
+		const unsigned int written = buffer->written;
+		SDL_MemoryBarrierAcquire();
+
+		const unsigned int first = (written > PROFILER_EVENTS_PER_THREAD) ? written - PROFILER_EVENTS_PER_THREAD : 0;
+
+		vector<ProfileEvent> events;
+
+		for (unsigned int i = first; i < written; i++) {
+			events.push_back(buffer->events[i & (PROFILER_EVENTS_PER_THREAD - 1)]);
+		}
+
+		// The next event may be half written too...
+
+		SDL_MemoryBarrierAcquire();
+		const unsigned int written_after = buffer->written + 1;
+
+		if (written_after - first > PROFILER_EVENTS_PER_THREAD) {
+
+			unsigned int overwritten = written_after - first - PROFILER_EVENTS_PER_THREAD;
+
+			if (overwritten > events.size()) overwritten = events.size();
+
+			events.erase(events.begin(), events.begin() + overwritten);
+		}
+
+		for (unsigned int i = 0; i < events.size(); i++) {
+			if (is_first || events[i].start_ticks < first_ticks) {
+				first_ticks = events[i].start_ticks;
+				is_first = false;
+			}
+		}
+
+		number_of_events += events.size();
+
+		thread_buffers.push_back(buffer);
+		thread_events.push_back(events);
+	}
+
+	// ##### Write the trace...
+
+	ofstream file(path.c_str());
+
+	if (file.is_open() == false) {
+		cerr << "ERROR: Could not write profile " << path << "!" << endl;
+		return false;
+	}
+
+	const double microseconds_per_tick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+	map<const char*, string> zone_names;
+
+	file.setf(ios::fixed);
+	file.precision(3);
+
+	file << "{\"traceEvents\":[" << endl;
+
+	bool is_first_event = true;
+
+	for (unsigned int t = 0; t < thread_buffers.size(); t++) {
+
+		const ProfileBuffer* buffer = thread_buffers[t];
+
+		// Thread name...
+
+		if (is_first_event == false) file << "," << endl;
+		is_first_event = false;
+
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_index << ",\"args\":{\"name\":\"";
+
+		if (buffer->thread_name != NULL) {
+			file << EscapeJSON(buffer->thread_name);
+		} else {
+			file << "thread " << buffer->thread_index;
+		}
+
+		file << "\"}}";
+
+		// Zones, as complete events (microseconds)...
+
+		const vector<ProfileEvent>& events = thread_events[t];
+
+		for (unsigned int i = 0; i < events.size(); i++) {
+
+			const ProfileEvent& event = events[i];
+
+			map<const char*, string>::iterator zone_name = zone_names.find(event.name);
+
+			if (zone_name == zone_names.end()) {
+				zone_name = zone_names.insert(make_pair(event.name, EscapeJSON(ZoneName(event.name)))).first;
+			}
+
+			file << "," << endl
+				<< "{\"name\":\"" << zone_name->second << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index
+				<< ",\"ts\":" << (double)(event.start_ticks - first_ticks) * microseconds_per_tick
+				<< ",\"dur\":" << (double)(event.end_ticks - event.start_ticks) * microseconds_per_tick
+				<< "}";
+		}
+	}
+
+	file << endl << "]}" << endl;
+
+	if (file.fail()) {
+		cerr << "ERROR: Could not write profile " << path << "!" << endl;
+		return false;
+	}
+
+	cout << "Profile of " << number_of_events << " zones on " << thread_buffers.size() << " threads written to " << path << endl;
+
+	return true;
+}
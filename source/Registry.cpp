@@ -0,0 +1,184 @@
+#include "Registry.hpp"
+#include "Misc.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cassert>
+
+Registry::Registry(const string& name) : System(name) {
+	SetTickRate(REGISTRY_TICK_RATE);
+}
+
+Registry::~Registry() {
+
+	/* Note:
+	 * Models still loading are left alone,
+	 * a worker may be writing to them.
+	 */
+
+	for (ModelMap::iterator itr = models.begin(); itr != models.end(); itr++) {
+		if (itr->second.load.IsDone()) {
+			delete itr->second.model;
+		}
+	}
+
+	models.clear();
+	model_keys.clear();
+
+	for (unsigned int i = 0; i < released_models.size(); i++) {
+		if (released_models[i].load.IsDone()) {
+			delete released_models[i].model;
+		}
+	}
+
+	released_models.clear();
+}
+
+void Registry::Update(const unsigned int&) {
+
+	vector<ModelEntry>::iterator itr = released_models.begin();
+
+	while (itr != released_models.end()) {
+
+		if (itr->load.IsDone() == false) {
+			itr++;
+			continue;
+		}
+
+		delete itr->model;
+		itr = released_models.erase(itr);
+	}
+}
+
+string Registry::GetModelKey(const AnimationInfo& animation_info) {
+
+	stringstream key;
+
+	key << CanonicalPath(animation_info.GetModelPath()) << "\n" << CanonicalPath(animation_info.GetTexturePath());
+
+	const ActionMap& actions = animation_info.GetActions();
+
+	for (ActionMap::const_iterator itr = actions.begin(); itr != actions.end(); itr++) {
+		key << "\n" << itr->second.type << " " << itr->second.loop << " " << itr->second.frameIndexOffset << " " << itr->second.numberOfFrames;
+	}
+
+	return key.str();
+}
+
+LoadHandle<AnimationModel*> Registry::InsertModel(const string& key, const string& name, const LoadHandle<AnimationModel*>& load) {
+
+	cout << "Registering model " << name << endl;
+
+	ModelEntry entry;
+
+	entry.key = key;
+	entry.name = name;
+	entry.load = load;
+	entry.model = entry.load.Get();
+
+	models[key] = entry;
+	model_keys[entry.model] = key;
+
+	return entry.load;
+}
+
+LoadHandle<AnimationModel*> Registry::LoadModel(const string& act_path, const ModelLoadMode& load_mode, const KeyframeStorage& keyframe_storage) {
+
+	const AnimationInfo animation_info(act_path);
+
+	if (animation_info.IsLoaded()) {
+		return LoadModel(animation_info, load_mode, keyframe_storage);
+	}
+
+	// Unreadable: registered by its ACT file, the load fails as any other (see LoadHandle::IsFailed)...
+
+	const string key = CanonicalPath(act_path);
+
+	ModelMap::iterator results = models.find(key);
+
+	if (results != models.end()) { // Shared!
+		return results->second.load;
+	}
+
+	return InsertModel(key, key, SystemInstance<Loader>()->LoadModel(act_path, load_mode, keyframe_storage));
+}
+
+LoadHandle<AnimationModel*> Registry::LoadModel(const AnimationInfo& animation_info, const ModelLoadMode& load_mode, const KeyframeStorage& keyframe_storage) {
+
+	const string key = GetModelKey(animation_info);
+
+	ModelMap::iterator results = models.find(key);
+
+	if (results != models.end()) { // Shared!
+		return results->second.load;
+	}
+
+	const string name = CanonicalPath(animation_info.GetModelPath()) + ", " + CanonicalPath(animation_info.GetTexturePath());
+
+	return InsertModel(key, name, SystemInstance<Loader>()->LoadModel(animation_info, load_mode, keyframe_storage));
+}
+
+AnimationModel* Registry::AcquireModel(const string& act_path, const ModelLoadMode& load_mode, const KeyframeStorage& keyframe_storage) {
+
+	LoadHandle<AnimationModel*> load = LoadModel(act_path, load_mode, keyframe_storage);
+
+	load.Wait();
+
+	return load.Get();
+}
+
+bool Registry::IsRegistered(AnimationModel* model) {
+	return (model_keys.find(model) != model_keys.end());
+}
+
+void Registry::DeleteModel(ModelEntry& entry) {
+
+	cout << "Unregistering model " << entry.name << endl;
+
+	if (entry.load.IsDone() == false) {
+		released_models.push_back(entry); // Deleted by Update once loaded
+		return;
+	}
+
+	delete entry.model;
+}
+
+void Registry::ReleaseModel(AnimationModel* model) {
+
+	if (model->Release() > 0) return;
+
+	map<AnimationModel*, string>::iterator key = model_keys.find(model);
+
+	if (key == model_keys.end()) return; // Not registered
+
+	ModelMap::iterator results = models.find(key->second);
+
+	assert(results != models.end());
+
+	ModelEntry entry = results->second;
+
+	models.erase(results);
+	model_keys.erase(key);
+
+	DeleteModel(entry);
+}
+
+size_t Registry::ReportMemory() {
+
+	size_t total_size = 0;
+
+	for (ModelMap::iterator itr = models.begin(); itr != models.end(); itr++) {
+
+		if (itr->second.load.IsReady() == false) continue; // Still loading
+
+		const size_t size = itr->second.model->GetMemorySize();
+
+		cout << itr->second.name << ": Memory " << size << " bytes, references " << itr->second.model->GetReferenceCount() << endl;
+
+		total_size += size;
+	}
+
+	cout << "Models " << models.size() << ", memory " << total_size << " bytes" << endl;
+
+	return total_size;
+}
@@ -0,0 +1,137 @@
+#include "StateCache.hpp"
+
+#include <GL/gl.h>
+
+using namespace std;
+
+StateCache::StateCache() :
+		is_texture_known(false),
+		bound_texture(0),
+		is_line_width_known(false),
+		line_width(1.0f),
+		issued_calls(0),
+		filtered_calls(0),
+		frame_issued_calls(0),
+		frame_filtered_calls(0) {}
+
+void StateCache::Invalidate() {
+
+	capabilities.clear();
+	client_states.clear();
+
+	is_texture_known = false;
+	is_line_width_known = false;
+
+	light_parameters.clear();
+}
+
+bool StateCache::Change(map<unsigned int, bool>& states, const unsigned int& key, const bool& value) {
+
+	map<unsigned int, bool>::iterator state = states.find(key);
+
+	if (state != states.end() && state->second == value) {
+		filtered_calls++;
+		return false;
+	}
+
+	states[key] = value;
+	issued_calls++;
+
+	return true;
+}
+
+void StateCache::Enable(const unsigned int& capability) {
+	if (Change(capabilities, capability, true)) glEnable(capability);
+}
+
+void StateCache::Disable(const unsigned int& capability) {
+	if (Change(capabilities, capability, false)) glDisable(capability);
+}
+
+void StateCache::EnableClientState(const unsigned int& array) {
+	if (Change(client_states, array, true)) glEnableClientState(array);
+}
+
+void StateCache::DisableClientState(const unsigned int& array) {
+	if (Change(client_states, array, false)) glDisableClientState(array);
+}
+
+void StateCache::BindTexture(const unsigned int& texture_id) {
+
+	if (is_texture_known && bound_texture == texture_id) {
+		filtered_calls++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture_id);
+
+	is_texture_known = true;
+	bound_texture = texture_id;
+	issued_calls++;
+}
+
+void StateCache::DeleteTexture(const unsigned int& texture_id) {
+
+	glDeleteTextures(1, &texture_id);
+
+	// Deleting the bound texture binds 0...
+
+	if (is_texture_known && bound_texture == texture_id) bound_texture = 0;
+}
+
+void StateCache::LineWidth(const float& width) {
+
+	if (is_line_width_known && line_width == width) {
+		filtered_calls++;
+		return;
+	}
+
+	glLineWidth(width);
+
+	is_line_width_known = true;
+	line_width = width;
+	issued_calls++;
+}
+
+void StateCache::Light(const unsigned int& light, const unsigned int& parameter, const float* parameters, const unsigned int& count) {
+
+	// Transformed by the modelview matrix, see note...
+
+	if (parameter == GL_POSITION || parameter == GL_SPOT_DIRECTION) {
+		glLightfv(light, parameter, parameters);
+		issued_calls++;
+		return;
+	}
+
+	LightParameter& state = light_parameters[make_pair(light, parameter)];
+
+	bool is_same = (state.count == count);
+
+	for (unsigned int i = 0; i < count && is_same; i++) {
+		is_same = (state.values[i] == parameters[i]);
+	}
+
+	if (is_same) {
+		filtered_calls++;
+		return;
+	}
+
+	glLightfv(light, parameter, parameters);
+
+	state.count = count;
+
+	for (unsigned int i = 0; i < count; i++) {
+		state.values[i] = parameters[i];
+	}
+
+	issued_calls++;
+}
+
+void StateCache::EndFrame() {
+
+	frame_issued_calls = issued_calls;
+	frame_filtered_calls = filtered_calls;
+
+	issued_calls = 0;
+	filtered_calls = 0;
+}
@@ -0,0 +1,428 @@
+#include "Subdivision.hpp"
+#include "Profiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <utility>
+
+#include <cassert>
+
+using namespace std;
+
+unsigned int SubdividedVertexCount(const unsigned int& depth) {
+	return 3 * (1 << (2 * depth)); // Each step splits a triangle into 4
+}
+
+// Appends the barycentric weights of the subdivided triangle (a, b, c), in the order of the recursive split
+static void SubdivideWeights( // Warning: Recursive function
+	unsigned int depth,
+	vector<float>& weights,
+	const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+
+	if (depth == 0) {
+
+		const glm::vec3 corners[3] = {a, b, c};
+
+		for (unsigned char i = 0; i < 3; i++) {
+			weights.push_back(corners[i][0]);
+			weights.push_back(corners[i][1]);
+			weights.push_back(corners[i][2]);
+		}
+
+		return;
+	}
+
+	// Points for new triangles, along the triangle edges...
+	const glm::vec3 x = 0.5f * (a + b);
+	const glm::vec3 y = 0.5f * (a + c);
+	const glm::vec3 z = 0.5f * (b + c);
+
+	/* Note:
+	 * Pushing the new points along the normal (for more natural polygon models)
+	 * opens holes in expanded subdivision: neighbouring triangles compute their edge points separately.
+	 * Indexed subdivision computes each edge point once, so a displacement of it is shared (see BuildTopology).
+	 */
+
+	depth--;
+
+	SubdivideWeights(depth, weights, a, x, y);
+	SubdivideWeights(depth, weights, x, b, z);
+	SubdivideWeights(depth, weights, y, z, c);
+	SubdivideWeights(depth, weights, z, y, x);
+}
+
+// Blends N components of the corners a, b and c
+template<int N>
+static inline void Blend(const float* weights, const float* a, const float* b, const float* c, float* result) {
+	for (int i = 0; i < N; i++) {
+		result[i] = weights[0] * a[i] + weights[1] * b[i] + weights[2] * c[i];
+	}
+}
+
+// Batch of a ParallelFor, see Subdivide and SubdivideIndexed
+struct SubdivisionBatch {
+	const SubdivisionTemplate*  pattern;
+	const SubdivisionTopology*  topology;
+	SubdivisionInput            input;
+	SubdivisionOutput           output;
+};
+
+static void SubdivideJob(void* data, const unsigned int& first_triangle, const unsigned int& number_of_triangles) {
+
+	PROFILE_ZONE("Subdivision::SubdivideRange");
+
+	const SubdivisionBatch* batch = (const SubdivisionBatch*)data;
+
+	Subdivision::SubdivideRange(*batch->pattern, batch->input, first_triangle, number_of_triangles, batch->output);
+}
+
+static void SubdivideIndexedJob(void* data, const unsigned int& first_vertex, const unsigned int& number_of_vertices) {
+
+	PROFILE_ZONE("Subdivision::SubdivideIndexedRange");
+
+	const SubdivisionBatch* batch = (const SubdivisionBatch*)data;
+
+	Subdivision::SubdivideIndexedRange(*batch->topology, batch->input, first_vertex, number_of_vertices, batch->output);
+}
+
+Subdivision::Subdivision(const string& name) : System(name) {
+
+	SetTickRate(SYSTEM_TICK_NEVER); // Only serves Subdivide
+
+	for (unsigned int depth = 0; depth <= SUBDIVISION_MAX_DEPTH; depth++) {
+		BuildTemplate(depth);
+	}
+
+	jobs = SystemInstance<JobSystem>();
+}
+
+Subdivision::~Subdivision() {
+}
+
+void Subdivision::BuildTemplate(const unsigned int& depth) {
+
+	SubdivisionTemplate& pattern = templates[depth];
+
+	pattern.depth = depth;
+	pattern.number_of_vertices = SubdividedVertexCount(depth);
+
+	pattern.weights.clear();
+	pattern.weights.reserve(3 * pattern.number_of_vertices);
+
+	SubdivideWeights(
+		depth,
+		pattern.weights,
+		glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f));
+
+	assert(pattern.weights.size() == 3 * pattern.number_of_vertices);
+}
+
+const SubdivisionTemplate& Subdivision::GetTemplate(const unsigned int& depth) {
+	return templates[(depth < SUBDIVISION_MAX_DEPTH) ? depth : SUBDIVISION_MAX_DEPTH];
+}
+
+void Subdivision::SubdivideRange(
+	const SubdivisionTemplate& pattern,
+	const SubdivisionInput& input,
+	const unsigned int& first_triangle,
+	const unsigned int& number_of_triangles,
+	const SubdivisionOutput& output) {
+
+	/* Note:
+	 * One pass per triangle: every attribute of an output vertex is blended with the same weights,
+	 * so the corners and the weights are read once and the outputs are written in order.
+	 */
+
+	const unsigned int number_of_vertices = pattern.number_of_vertices;
+	const float* weights = &pattern.weights[0];
+
+	for (unsigned int t = first_triangle; t < first_triangle + number_of_triangles; t++) {
+
+		const unsigned short* corners = input.triangle_indices + 3 * t;
+
+		const float* texture_coordinates[3];
+		const float* colours[3];
+		const float* normals[3];
+		const float* vertices[3];
+
+		for (unsigned char j = 0; j < 3; j++) {
+			texture_coordinates[j] = input.texture_coordinates + 2 * corners[j];
+			colours[j] = input.colours + 3 * corners[j];
+			normals[j] = input.normals + 3 * corners[j];
+			vertices[j] = input.vertices + 3 * corners[j];
+		}
+
+		const unsigned int first_vertex = t * number_of_vertices;
+
+		float* texture_coordinate_output = output.texture_coordinates + 2 * first_vertex;
+		float* colour_output = output.colours + 3 * first_vertex;
+		float* normal_output = output.normals + 3 * first_vertex;
+		float* vertex_output = output.vertices + 3 * first_vertex;
+
+		for (unsigned int i = 0; i < number_of_vertices; i++) {
+
+			const float* w = weights + 3 * i;
+
+			Blend<2>(w, texture_coordinates[0], texture_coordinates[1], texture_coordinates[2], texture_coordinate_output + 2 * i);
+			Blend<3>(w, colours[0], colours[1], colours[2], colour_output + 3 * i);
+			Blend<3>(w, normals[0], normals[1], normals[2], normal_output + 3 * i);
+			Blend<3>(w, vertices[0], vertices[1], vertices[2], vertex_output + 3 * i);
+		}
+	}
+}
+
+void Subdivision::Subdivide(
+	const unsigned int& depth,
+	const SubdivisionInput& input,
+	const unsigned int& number_of_triangles,
+	const SubdivisionOutput& output) {
+
+	const SubdivisionTemplate& pattern = GetTemplate(depth);
+
+	// Small batches cost less than jobs...
+
+	if (number_of_triangles * pattern.number_of_vertices < SUBDIVISION_PARALLEL_VERTICES) {
+		SubdivideRange(pattern, input, 0, number_of_triangles, output);
+		return;
+	}
+
+	SubdivisionBatch batch;
+
+	batch.pattern = &pattern;
+	batch.topology = NULL;
+	batch.input = input;
+	batch.output = output;
+
+	jobs->ParallelFor(SubdivideJob, &batch, number_of_triangles, SUBDIVISION_RANGE_TRIANGLES);
+}
+
+void Subdivision::BuildTopology(
+	const unsigned int& depth,
+	const unsigned short* triangle_indices,
+	const unsigned int& number_of_triangles,
+	const float* texture_coordinates,
+	SubdivisionTopology& topology) {
+
+	const SubdivisionTemplate& pattern = GetTemplate(depth);
+
+	/* Note:
+	 * Each template vertex is a point of the triangle lattice: (i, j, k) = N * weights, where N = 2^depth.
+	 * - Corner: one weight is N, shared by every triangle using the shaded vertex
+	 * - Edge: one weight is 0, shared by the triangles of the edge (keyed by its shaded vertices)
+	 * - Interior: no weight is 0, only used by its own triangle
+	 * Points of an edge are numbered from its lower shaded vertex, so both triangles find the same point.
+	 * Texture seams split the shaded vertices, so edges across a seam are not shared.
+	 */
+
+	const unsigned int N = 1 << pattern.depth;
+
+	// Lattice coordinates of the template vertices (the weights are exact halves)...
+
+	vector<unsigned int> lattice(3 * pattern.number_of_vertices);
+
+	for (unsigned int i = 0; i < lattice.size(); i++) {
+		lattice[i] = (unsigned int)(pattern.weights[i] * N + 0.5f);
+	}
+
+	// Interior slots, indexed by the lattice coordinates i and j...
+
+	vector<unsigned int> interior_slots((N + 1) * (N + 1), 0);
+
+	unsigned int number_of_interior_vertices = 0;
+
+	for (unsigned int i = 1; i < N; i++) {
+		for (unsigned int j = 1; i + j < N; j++) {
+			interior_slots[i * (N + 1) + j] = number_of_interior_vertices++;
+		}
+	}
+
+	topology.depth = pattern.depth;
+	topology.vertices.clear();
+	topology.triangle_indices.clear();
+	topology.triangle_indices.reserve(number_of_triangles * pattern.number_of_vertices);
+
+	vector<unsigned int> corner_vertices;                           // Per shaded vertex, -1 until used
+	map<pair<unsigned short, unsigned short>, unsigned int> edges;  // First of the N - 1 points of an edge
+
+	const unsigned int unused = (unsigned int)-1;
+
+	for (unsigned int t = 0; t < number_of_triangles; t++) {
+
+		const unsigned short* corners = triangle_indices + 3 * t;
+
+		// Corners...
+
+		unsigned int corner_ids[3];
+
+		for (unsigned char c = 0; c < 3; c++) {
+
+			if (corner_vertices.size() <= corners[c]) corner_vertices.resize(corners[c] + 1, unused);
+
+			if (corner_vertices[corners[c]] == unused) {
+
+				SubdividedVertex vertex;
+
+				vertex.corners[0] = vertex.corners[1] = vertex.corners[2] = corners[c];
+				vertex.weights[0] = 1.0f;
+				vertex.weights[1] = vertex.weights[2] = 0.0f;
+
+				corner_vertices[corners[c]] = topology.vertices.size();
+				topology.vertices.push_back(vertex);
+			}
+
+			corner_ids[c] = corner_vertices[corners[c]];
+		}
+
+		// Edges: ab, bc, ca...
+
+		unsigned int edge_ids[3];
+
+		for (unsigned char e = 0; e < 3; e++) {
+
+			const unsigned short p = corners[e];
+			const unsigned short q = corners[(e + 1) % 3];
+
+			if (p == q) continue; // Degenerate: every point is the corner
+
+			const pair<unsigned short, unsigned short> key((p < q) ? p : q, (p < q) ? q : p);
+
+			map<pair<unsigned short, unsigned short>, unsigned int>::iterator edge = edges.find(key);
+
+			if (edge == edges.end()) {
+
+				edge = edges.insert(make_pair(key, (unsigned int)topology.vertices.size())).first;
+
+				for (unsigned int n = 1; n < N; n++) {
+
+					SubdividedVertex vertex;
+
+					vertex.corners[0] = key.first;
+					vertex.corners[1] = key.second;
+					vertex.corners[2] = key.first;
+					vertex.weights[0] = float(N - n) / N;
+					vertex.weights[1] = float(n) / N;
+					vertex.weights[2] = 0.0f;
+
+					topology.vertices.push_back(vertex);
+				}
+			}
+
+			edge_ids[e] = edge->second;
+		}
+
+		// Interior...
+
+		const unsigned int first_interior = topology.vertices.size();
+
+		for (unsigned int i = 1; i < N; i++) {
+			for (unsigned int j = 1; i + j < N; j++) {
+
+				SubdividedVertex vertex;
+
+				vertex.corners[0] = corners[0];
+				vertex.corners[1] = corners[1];
+				vertex.corners[2] = corners[2];
+				vertex.weights[0] = float(i) / N;
+				vertex.weights[1] = float(j) / N;
+				vertex.weights[2] = float(N - i - j) / N;
+
+				topology.vertices.push_back(vertex);
+			}
+		}
+
+		// Indices, in the order of the template...
+
+		for (unsigned int v = 0; v < pattern.number_of_vertices; v++) {
+
+			const unsigned int* w = &lattice[3 * v];
+
+			unsigned int id;
+
+			if (w[0] == N) id = corner_ids[0];
+			else if (w[1] == N) id = corner_ids[1];
+			else if (w[2] == N) id = corner_ids[2];
+			else if (w[0] != 0 && w[1] != 0 && w[2] != 0) id = first_interior + interior_slots[w[0] * (N + 1) + w[1]];
+			else {
+
+				// On the edge from corner e to corner e + 1 (the weight of the third corner is 0)...
+
+				const unsigned char e = (w[2] == 0) ? 0 : ((w[0] == 0) ? 1 : 2);
+
+				const unsigned short p = corners[e];
+				const unsigned short q = corners[(e + 1) % 3];
+
+				const unsigned int wq = w[(e + 1) % 3];
+
+				if (p == q) id = corner_ids[e];
+				else id = edge_ids[e] + ((p < q) ? wq : N - wq) - 1;
+			}
+
+			topology.triangle_indices.push_back(id);
+		}
+	}
+
+	// Texture coordinates are static...
+
+	topology.texture_coordinates.resize(2 * topology.vertices.size());
+
+	for (unsigned int v = 0; v < topology.vertices.size(); v++) {
+
+		const SubdividedVertex& vertex = topology.vertices[v];
+
+		Blend<2>(
+			vertex.weights,
+			texture_coordinates + 2 * vertex.corners[0],
+			texture_coordinates + 2 * vertex.corners[1],
+			texture_coordinates + 2 * vertex.corners[2],
+			&topology.texture_coordinates[2 * v]);
+	}
+
+}
+
+void Subdivision::SubdivideIndexedRange(
+	const SubdivisionTopology& topology,
+	const SubdivisionInput& input,
+	const unsigned int& first_vertex,
+	const unsigned int& number_of_vertices,
+	const SubdivisionOutput& output) {
+
+	for (unsigned int v = first_vertex; v < first_vertex + number_of_vertices; v++) {
+
+		const SubdividedVertex& vertex = topology.vertices[v];
+
+		const unsigned short a = vertex.corners[0];
+		const unsigned short b = vertex.corners[1];
+		const unsigned short c = vertex.corners[2];
+
+		Blend<3>(vertex.weights, input.colours + 3 * a, input.colours + 3 * b, input.colours + 3 * c, output.colours + 3 * v);
+		Blend<3>(vertex.weights, input.normals + 3 * a, input.normals + 3 * b, input.normals + 3 * c, output.normals + 3 * v);
+		Blend<3>(vertex.weights, input.vertices + 3 * a, input.vertices + 3 * b, input.vertices + 3 * c, output.vertices + 3 * v);
+	}
+}
+
+void Subdivision::SubdivideIndexed(
+	const SubdivisionTopology& topology,
+	const SubdivisionInput& input,
+	const SubdivisionOutput& output) {
+
+	const unsigned int number_of_vertices = topology.vertices.size();
+
+	// Small batches cost less than jobs...
+
+	if (number_of_vertices < SUBDIVISION_PARALLEL_VERTICES) {
+		SubdivideIndexedRange(topology, input, 0, number_of_vertices, output);
+		return;
+	}
+
+	SubdivisionBatch batch;
+
+	batch.pattern = NULL;
+	batch.topology = &topology;
+	batch.input = input;
+	batch.output = output;
+
+	jobs->ParallelFor(SubdivideIndexedJob, &batch, number_of_vertices, SUBDIVISION_RANGE_VERTICES);
+}
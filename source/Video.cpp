@@ -1,8 +1,12 @@
 #include "Process.hpp"
 #include "Video.hpp"
 #include "Input.hpp"
+#include "Loader.hpp"
+#include "Animator.hpp"
+#include "Subdivision.hpp"
 
 #include "Drawable.hpp"
+#include "Profiler.hpp"
 
 #include "Misc.hpp"
 
@@ -112,131 +116,6 @@ void SetPixel(void* image, const unsigned int& x, const unsigned int& y, const C
 	SDL_UnlockSurface(surface);
 }
 
-void Subdivide3D(
-	unsigned int depth,
-	vector<float>& buffer,
-	const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
-	
-	// Recursive base-case...
-	
-	if (depth == 0) {
-		
-		// a is vertex[0]
-		buffer.push_back(a[X]);
-		buffer.push_back(a[Y]);
-		buffer.push_back(a[Z]);
-		
-		// b is vertex[1]
-		buffer.push_back(b[X]);
-		buffer.push_back(b[Y]);
-		buffer.push_back(b[Z]);
-		
-		// c is vertex[2]
-		buffer.push_back(c[X]);
-		buffer.push_back(c[Y]);
-		buffer.push_back(c[Z]);
-		
-		return;
-	}
-	
-	/*          [a]
-	 *          / \
-	 *         /   \
-	 *     (x)/-----\(y)
-	 *       / \   / \
-	 *      /___\ /___\
-	 *    [b]   (z)   [c]
-	 */
-	
-	// Calculate vertices along the triangle edges...
-	glm::vec3 u = (b - a);
-	glm::vec3 v = (c - a);
-	glm::vec3 w = (c - b);
-	
-	// Calculate points for new triangles...
-	glm::vec3 x = a + 0.5f * u;
-	glm::vec3 y = a + 0.5f * v;
-	glm::vec3 z = b + 0.5f * w;
-	
-	// Push vertices along normal...
-	
-	/* Note:
-	 * Attempted at rendering more natural polygon models.
-	 * This has noticeable side-effects:
-	 * - Edges are not attached, ie. holes in out model!
-	 * - Increasing subdivision can help, but run-time increases exponentially!
-	 */
-	
-	/*
-	glm::vec3 N = glm::cross(u, v);
-	x += 0.01f*N;
-	y += 0.01f*N;
-	z += 0.01f*N;
-	*/
-	
-	// Recursive step...
-	
-	depth--;
-	
-	Subdivide3D(depth, buffer, a, x, y);
-	Subdivide3D(depth, buffer, x, b, z);
-	Subdivide3D(depth, buffer, y, z, c);
-	Subdivide3D(depth, buffer, z, y, x);
-}
-
-void Subdivide2D(
-	unsigned int depth,
-	vector<float>& buffer,
-	const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
-	
-	/*          [a]
-	 *          / \
-	 *         /   \
-	 *     (x)/-----\(y)
-	 *       / \   / \
-	 *      /___\ /___\
-	 *    [b]   (z)   [c]
-	 */
-	
-	// Recursive base-case...
-	
-	if (depth == 0) {
-		
-		// a is vertex[0]
-		buffer.push_back(a[X]);
-		buffer.push_back(a[Y]);
-		
-		// b is vertex[1]
-		buffer.push_back(b[X]);
-		buffer.push_back(b[Y]);
-		
-		// c is vertex[2]
-		buffer.push_back(c[X]);
-		buffer.push_back(c[Y]);
-		
-		return;
-	}
-	
-	// Calculate vertices along the triangle edges...
-	glm::vec2 u = (b - a);
-	glm::vec2 v = (c - a);
-	glm::vec2 w = (c - b);
-	
-	// Calculate points for new triangles...
-	glm::vec2 x = a + 0.5f * u;
-	glm::vec2 y = a + 0.5f * v;
-	glm::vec2 z = b + 0.5f * w;
-	
-	// Recursive step...
-	
-	depth--;
-	
-	Subdivide2D(depth, buffer, a, x, y);
-	Subdivide2D(depth, buffer, x, b, z);
-	Subdivide2D(depth, buffer, y, z, c);
-	Subdivide2D(depth, buffer, z, y, x);
-}
-
 void* toon_filter(
 	void* image,
 	const unsigned int& width,
@@ -317,16 +196,47 @@ TextureFilter TextureFilter_Toon = &toon_filter;
 
 Video::Video(const string& name) : System(name) {
 	
+	// Draw after the camera moved, the models uploaded and the animations advanced...
+	
+	RunAfter(&typeid(Input));
+	RunAfter(&typeid(Loader));
+	RunAfter(&typeid(Animator));
+	
 	// Set defaults
 	
 	enable_interpolation = true;
 	enable_subdivision = true;
+	enable_indexed_subdivision = true;
 	enable_celshading = true;
 	enable_motion_blur = false;
+	enable_lighting_table = true;
+	enable_vertical_sync = false; // See SetVerticalSync, once there is a context
+	
+	subdivision_depth = 2;
+	
+	enable_adaptive_subdivision = true;
+	subdivision_threshold = VIDEO_SUBDIVISION_THRESHOLD;
+	subdivision_hysteresis = VIDEO_SUBDIVISION_HYSTERESIS;
+	
+	viewport_height = VIDEO_HEIGHT;
 	
 	debug_lighting = false;
 	debug_normals = false;
 	debug_view = false;
+	
+	debug_lines_dropped = 0;
+	debug_lines_were_dropped = false;
+	debug_vector_step = 1;
+	
+	mesh_path = MESH_INDEXED;
+	
+	vertex_count = 0;
+	
+	pose_cache_steps = VIDEO_POSE_CACHE_STEPS;
+	pose_cache_hits = 0;
+	pose_cache_misses = 0;
+	
+	frame_number = 0;
 
 	// ...
 	
@@ -395,6 +305,8 @@ Video::Video(const string& name) : System(name) {
 		return;
 	}
 	
+	SetVerticalSync(VIDEO_VERTICAL_SYNC);
+	
 	// ...
 	
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -403,8 +315,8 @@ Video::Video(const string& name) : System(name) {
 	
 	// ...
 	
-	glEnable(GL_LINE_SMOOTH);
-	glEnable(GL_DEPTH_TEST);
+	state_cache.Enable(GL_LINE_SMOOTH);
+	state_cache.Enable(GL_DEPTH_TEST);
 	
 	// Setup lighting...
 	
@@ -418,11 +330,11 @@ Video::Video(const string& name) : System(name) {
 	GLfloat light_specular[]    = { 0.5f, 0.5f, 0.5f, 1.0f };
 	GLfloat light_ambient[]     = { 0.8f, 0.8f, 0.2f, 1.0f };
 	
-	glLightfv(GL_LIGHT0, GL_DIFFUSE,    light_diffuse);
-	glLightfv(GL_LIGHT0, GL_SPECULAR,   light_specular);
-	glLightfv(GL_LIGHT0, GL_AMBIENT,    light_ambient);
+	state_cache.Light(GL_LIGHT0, GL_DIFFUSE,    light_diffuse, 4);
+	state_cache.Light(GL_LIGHT0, GL_SPECULAR,   light_specular, 4);
+	state_cache.Light(GL_LIGHT0, GL_AMBIENT,    light_ambient, 4);
 	
-	glEnable(GL_COLOR_MATERIAL);
+	state_cache.Enable(GL_COLOR_MATERIAL);
 	
 	glMaterialfv(GL_FRONT, GL_DIFFUSE,  material_diffuse);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, material_specular);
@@ -431,8 +343,8 @@ Video::Video(const string& name) : System(name) {
 	glMaterialf(GL_FRONT, GL_SHININESS, material_shininess);
 	
 	glShadeModel(GL_SMOOTH);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
+	state_cache.Enable(GL_LIGHTING);
+	state_cache.Enable(GL_LIGHT0);
 	
 	// Setup fog...
 	
@@ -446,7 +358,7 @@ Video::Video(const string& name) : System(name) {
 	
 	glHint(GL_FOG_HINT, GL_FASTEST);
 	
-	glEnable(GL_FOG);
+	state_cache.Enable(GL_FOG);
 	
 	// Setup viewport and perspective matrix...
 	
@@ -466,6 +378,160 @@ Video::~Video() {
 	}
 }
 
+void Video::SetSubdivisionDepth(const unsigned int& depth) {
+	
+	subdivision_depth = (depth < SUBDIVISION_MAX_DEPTH) ? depth : SUBDIVISION_MAX_DEPTH;
+	
+	cout << "Subdivision depth " << subdivision_depth << endl;
+}
+
+bool Video::AddDebugLine(
+	const glm::vec4& source,
+	const glm::vec3& source_colour,
+	const glm::vec4& destination,
+	const glm::vec3& destination_colour) {
+	
+	if (VIDEO_DEBUG_MAX_LINES <= debug_line_vertices.size() / 6) {
+		debug_lines_dropped++;
+		return false;
+	}
+	
+	for (unsigned char i = 0; i < 3; i++) debug_line_vertices.push_back(source[i]);
+	for (unsigned char i = 0; i < 3; i++) debug_line_vertices.push_back(destination[i]);
+	
+	for (unsigned char i = 0; i < 3; i++) debug_line_colours.push_back(source_colour[i]);
+	for (unsigned char i = 0; i < 3; i++) debug_line_colours.push_back(destination_colour[i]);
+	
+	return true;
+}
+
+void Video::DrawDebugLines() {
+	
+	PROFILE_ZONE("Video::DrawDebugLines");
+	
+	// Cleared, not freed, so the buffers are only allocated while they grow...
+	
+	if (debug_line_vertices.empty() == false) {
+		
+		state_cache.Disable(GL_LIGHTING);
+		state_cache.Disable(GL_TEXTURE_2D);
+		state_cache.Enable(GL_LINE_SMOOTH);
+		state_cache.LineWidth(3.0f);
+		
+		state_cache.DisableClientState(GL_TEXTURE_COORD_ARRAY);
+		state_cache.DisableClientState(GL_NORMAL_ARRAY);
+		state_cache.EnableClientState(GL_COLOR_ARRAY);
+		state_cache.EnableClientState(GL_VERTEX_ARRAY);
+		
+		glColorPointer(3, GL_FLOAT, 0, &debug_line_colours[0]);
+		glVertexPointer(3, GL_FLOAT, 0, &debug_line_vertices[0]);
+		
+		glDrawArrays(GL_LINES, 0, debug_line_vertices.size() / 3);
+	}
+	
+	if (debug_lines_dropped > 0 && debug_lines_were_dropped == false) {
+		cout << "Debug lines dropped " << debug_lines_dropped << " (at most " << VIDEO_DEBUG_MAX_LINES << " per frame)" << endl;
+	}
+	
+	debug_line_vertices.clear();
+	debug_line_colours.clear();
+	debug_lines_were_dropped = (debug_lines_dropped > 0);
+	debug_lines_dropped = 0;
+}
+
+void Video::CycleDebugVectorStep() {
+	
+	debug_vector_step = (debug_vector_step < VIDEO_DEBUG_MAX_STEP) ? 2 * debug_vector_step : 1;
+	
+	cout << "Debug vectors every " << debug_vector_step << " vertices" << endl;
+}
+
+void Video::SetPoseCacheSteps(const unsigned int& steps) {
+	
+	pose_cache_steps = steps;
+	
+	if (pose_cache_steps == 0) cout << "Pose cache disabled" << endl;
+	else cout << "Pose cache steps " << pose_cache_steps << endl;
+}
+
+void Video::CyclePoseCacheSteps() {
+	
+	if (pose_cache_steps == 0) SetPoseCacheSteps(VIDEO_POSE_CACHE_STEPS / 2);
+	else if (pose_cache_steps < VIDEO_POSE_CACHE_MAX_STEPS) SetPoseCacheSteps(2 * pose_cache_steps);
+	else SetPoseCacheSteps(0);
+}
+
+void Video::SetVerticalSync(const bool& is_enabled) {
+	
+	enable_vertical_sync = (SDL_GL_SetSwapInterval(is_enabled ? 1 : 0) == 0) && is_enabled;
+	
+	if (is_enabled && enable_vertical_sync == false) {
+		cerr << "ERROR: Vertical sync is not supported!" << endl;
+		cerr << SDL_GetError() << endl;
+	}
+	
+	cout << "Vertical sync " << (enable_vertical_sync ? "on" : "off") << endl;
+}
+
+void Video::ToggleAdaptiveSubdivision() {
+	
+	enable_adaptive_subdivision = !enable_adaptive_subdivision;
+	
+	cout << "Subdivision " << (enable_adaptive_subdivision ? "adaptive" : "fixed") << endl;
+}
+
+void Video::SetSubdivisionThreshold(const float& threshold, const float& hysteresis) {
+	
+	subdivision_threshold = (threshold > 1.0f) ? threshold : 1.0f;
+	subdivision_hysteresis = glm::clamp(hysteresis, 0.0f, 1.0f);
+	
+	cout << "Subdivision threshold " << subdivision_threshold << " pixels, hysteresis " << subdivision_hysteresis << endl;
+}
+
+float Video::GetProjectedSize(const glm::vec4& position, const float& radius) {
+	
+	float distance = glm::length(position - GetViewPosition()); // Both points, so w is 0
+	
+	// Inside the sphere, as large as it gets...
+	
+	if (distance < radius) distance = radius;
+	if (distance <= 0.0f) return (float)viewport_height;
+	
+	const float half_fov_tangent = tanf(glm::radians(0.5f * VIDEO_FOV)); // See Resize
+	
+	return (radius / (distance * half_fov_tangent)) * (float)viewport_height;
+}
+
+unsigned int Video::SelectSubdivisionDepth(const float& projected_size, const unsigned int& previous_depth) {
+	
+	if (enable_adaptive_subdivision == false) return subdivision_depth;
+	
+	/* Note:
+	 * Depth d starts at subdivision_threshold * 2^(d - 1) pixels, so each depth keeps triangles about the same size on screen.
+	 * The depth only steps up past (1 + hysteresis) of a threshold, and only steps down below (1 - hysteresis) of it,
+	 * so an instance moving about a threshold does not flicker between depths.
+	 */
+	
+	unsigned int depth = (previous_depth < subdivision_depth) ? previous_depth : subdivision_depth;
+	
+	while (depth < subdivision_depth && subdivision_threshold * (1 << depth) * (1.0f + subdivision_hysteresis) <= projected_size) {
+		depth++;
+	}
+	
+	while (depth > 0 && projected_size < subdivision_threshold * (1 << (depth - 1)) * (1.0f - subdivision_hysteresis)) {
+		depth--;
+	}
+	
+	return depth;
+}
+
+void Video::ToggleIndexedSubdivision() {
+	
+	enable_indexed_subdivision = !enable_indexed_subdivision;
+	
+	cout << "Subdivision " << (enable_indexed_subdivision ? "indexed" : "expanded") << endl;
+}
+
 void Video::Update(const unsigned int& elapsed_milliseconds) {
 	
 	// Set the window context so that rendering is done in this window...
@@ -492,8 +558,8 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 	
-	glEnable(GL_LIGHTING);
-	glEnable(GL_DEPTH_TEST);
+	state_cache.Enable(GL_LIGHTING);
+	state_cache.Enable(GL_DEPTH_TEST);
 	
 	// Setup camera...
 	
@@ -512,12 +578,16 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 	
 	ResourceList* resources = engine.Resources();
 	
-	for (unsigned int i = 0; i < resources->size(); i++) {
+	vertex_count = 0;
+	pose_cache_hits = 0;
+	pose_cache_misses = 0;
+	
+	for (unsigned int i = 0; i < resources->Size(); i++) {
 		
-		Drawable* resource = (Drawable*)resources->at(i);
+		Drawable* resource = (Drawable*)resources->At(i);
 		
 		if (resource == NULL) {
-			cout << "Not drawable " << resources->at(i)->Name() << endl;
+			cout << "Not drawable " << resources->At(i)->Name() << endl;
 			continue;
 		}
 		
@@ -525,7 +595,7 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 		glMultMatrixf(glm::value_ptr(resource->GetOrientation()));
 		
 			// Apply light to model space
-			glLightfv(GL_LIGHT0, GL_POSITION, glm::value_ptr(resource->GetLightPosition()));
+			state_cache.Light(GL_LIGHT0, GL_POSITION, glm::value_ptr(resource->GetLightPosition()), 4);
 
 			// Update the resource
 
@@ -540,8 +610,15 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 		glPopMatrix();
 	}
 	
+	// Debug vectors of every model, in one draw...
+	
+	DrawDebugLines();
+	
 	// Draw light position...
 	
+	state_cache.Enable(GL_LIGHTING);
+	state_cache.Disable(GL_TEXTURE_2D);
+	
 	GLUquadricObj *sphere = gluNewQuadric();
 	
 	glTranslatef(light_position[X], light_position[Y], light_position[Z]);
@@ -617,6 +694,7 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 
 		if (accum_index == ACCUM_MAX) {
 			glAccum(GL_RETURN, 1.0f);
+			PROFILE_ZONE("SDL_GL_SwapWindow");
 			SDL_GL_SwapWindow((SDL_Window*)window);
 			glClear(GL_ACCUM_BUFFER_BIT);
 			accum_index = 0;
@@ -628,8 +706,16 @@ void Video::Update(const unsigned int& elapsed_milliseconds) {
 	}
 	else {
 		accum_index = 0; // Always start motion blur at accum index zero
+		PROFILE_ZONE("SDL_GL_SwapWindow");
 		SDL_GL_SwapWindow((SDL_Window*)window);
 	}
+	
+	// Release this frame's render buffers...
+	
+	frame_arena.Reset();
+	frame_number++;
+	
+	state_cache.EndFrame();
 }
 
 void Video::Resize(const int& width, const int& height) {
@@ -639,6 +725,8 @@ void Video::Resize(const int& width, const int& height) {
 	
 	glViewport(0, 0, width, height);
 	
+	viewport_height = height;
+	
 	// Reset projection matrix...
 
 	#define VIDEO_ASPECT ((float)width / (float)height)
@@ -698,7 +786,7 @@ bool Video::IsTexture(const unsigned int& texture_id) {
 	return true;
 }
 		
-unsigned int Video::LoadTexture(
+void* Video::DecodeTexture(
 	string const& path,
 	unsigned int& width,
 	unsigned int& height,
@@ -714,7 +802,7 @@ unsigned int Video::LoadTexture(
 	if (image == NULL) {
 		cerr << "ERROR: Failed to load texture!" << endl;
 		cerr << SDL_GetError() << endl;
-		return 0;
+		return NULL;
 	}
 
 	// Update width, height and bytes per pixel...
@@ -726,38 +814,21 @@ unsigned int Video::LoadTexture(
 
 	// Validate image format...
 
-	GLenum format;
-
 	switch (bytes_per_pixel) {
 
-		case 3: format = GL_RGB; break;
-		case 4: format = GL_RGBA; break;
+		case 3: break;
+		case 4: break;
 
 		default: { // Unknown format...
 
 			cerr << "ERROR: Failed to load texture, unknown format!" << endl;
-			cerr << gluErrorString(glGetError()) << endl;
 
 			SDL_FreeSurface(image);
-			return 0;
+			return NULL;
 
 		} break;
 	}
 
-	// Generate one texture...
-
-	GLuint texture_id = 0;
-	glGenTextures(1, &texture_id);
-
-	if (IsTexture(texture_id)) {
-
-		cerr << "ERROR: Failed to generate texture!" << endl;
-		cerr << gluErrorString(glGetError()) << endl;
-
-		SDL_FreeSurface(image);
-		return 0;
-	}
-
 	// Filter the texture...
 
 	if (filter != NULL) {
@@ -765,19 +836,49 @@ unsigned int Video::LoadTexture(
 		SDL_Surface* filtered_image = (SDL_Surface*)
 				filter((void*)image, width, height, bytes_per_pixel);
 
-		if (image == NULL) {
+		if (filtered_image == NULL) {
 			cerr << "ERROR: Failed to filter image!" << endl;
 
 			SDL_FreeSurface(image);
-			return 0;
+			return NULL;
 		}
 
 		image = filtered_image;
 	}
 
+	return (void*)image;
+}
+
+unsigned int Video::UploadTexture(void* decoded_image) {
+
+	SDL_Surface* image = (SDL_Surface*)decoded_image;
+
+	if (image == NULL) return 0;
+
+	const unsigned int width = image->w;
+	const unsigned int height = image->h;
+
+	const unsigned char bytes_per_pixel = image->format->BytesPerPixel;
+
+	GLenum format = (bytes_per_pixel == 4) ? GL_RGBA : GL_RGB;
+
+	// Generate one texture...
+
+	GLuint texture_id = 0;
+	glGenTextures(1, &texture_id);
+
+	if (IsTexture(texture_id)) {
+
+		cerr << "ERROR: Failed to generate texture!" << endl;
+		cerr << gluErrorString(glGetError()) << endl;
+
+		SDL_FreeSurface(image);
+		return 0;
+	}
+
 	// Load/render image into memory...
 
-	glBindTexture(GL_TEXTURE_2D, texture_id);
+	state_cache.BindTexture(texture_id);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, image->pixels);
 
 	// Assign texture parameters for rendering...
@@ -790,7 +891,7 @@ unsigned int Video::LoadTexture(
 
 	// Unbind texture...
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	state_cache.BindTexture(0);
 
 	// Clean up...
 
@@ -818,6 +919,84 @@ unsigned int Video::LoadTexture(
 
 	return texture_id;
 }
+
+void Video::FreeTexture(void* decoded_image) {
+	
+	if (decoded_image == NULL) return;
+	
+	SDL_FreeSurface((SDL_Surface*)decoded_image);
+}
+
+unsigned int Video::LoadTexture(
+	string const& path,
+	unsigned int& width,
+	unsigned int& height,
+	unsigned char& bytes_per_pixel,
+	TextureFilter filter) {
+
+	// Shared?
+
+	map<TextureKey, unsigned int>::iterator results = texture_ids.find(TextureKey(CanonicalPath(path), filter));
+
+	if (results != texture_ids.end()) {
+
+		TextureEntry& entry = textures[results->second];
+
+		entry.references++;
+
+		width = entry.width;
+		height = entry.height;
+		bytes_per_pixel = entry.bytes_per_pixel;
+
+		return results->second;
+	}
+
+	void* image = DecodeTexture(path, width, height, bytes_per_pixel, filter);
+
+	if (image == NULL) return 0;
+
+	return UploadTexture(image, path, filter);
+}
+
+unsigned int Video::UploadTexture(void* decoded_image, string const& path, TextureFilter filter) {
+
+	if (decoded_image == NULL) return 0;
+
+	TextureEntry entry;
+
+	entry.path = CanonicalPath(path);
+	entry.filter = filter;
+	entry.width = ((SDL_Surface*)decoded_image)->w;
+	entry.height = ((SDL_Surface*)decoded_image)->h;
+	entry.bytes_per_pixel = ((SDL_Surface*)decoded_image)->format->BytesPerPixel;
+	entry.references = 1;
+
+	// Shared?
+
+	map<TextureKey, unsigned int>::iterator results = texture_ids.find(TextureKey(entry.path, entry.filter));
+
+	if (results != texture_ids.end()) {
+
+		FreeTexture(decoded_image);
+
+		textures[results->second].references++;
+
+		return results->second;
+	}
+
+	return RegisterTexture(UploadTexture(decoded_image), entry);
+}
+
+unsigned int Video::RegisterTexture(const unsigned int& texture_id, const TextureEntry& entry) {
+
+	if (texture_id == 0) return 0;
+
+	texture_ids[TextureKey(entry.path, entry.filter)] = texture_id;
+	textures[texture_id] = entry;
+
+	return texture_id;
+}
+
 unsigned int Video::LoadTexture(
 	string const& path,
 	unsigned int& width,
@@ -829,7 +1008,21 @@ unsigned int Video::LoadTexture(
 
 void Video::UnloadTexture(const unsigned int& texture_id) {
 	
+	map<unsigned int, TextureEntry>::iterator results = textures.find(texture_id);
+	
+	if (results != textures.end()) { // Shared...
+		
+		TextureEntry& entry = results->second;
+		
+		entry.references--;
+		
+		if (entry.references > 0) return;
+		
+		texture_ids.erase(TextureKey(entry.path, entry.filter));
+		textures.erase(results);
+	}
+	
 	if (IsTexture(texture_id) == false) return;
 	
-	glDeleteTextures(1, &texture_id);
+	state_cache.DeleteTexture(texture_id);
 }